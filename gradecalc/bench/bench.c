@@ -0,0 +1,1080 @@
+// gradecalc_bench: generates a synthetic data set and times the loaders,
+// the calculator and the writer on it. Built and run by `make bench`;
+// linked with -Wl,--wrap for the allocator so allocations can be counted.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "csv.h"
+#include "scan.h"
+#include "grades.h"
+#include "calc.h"
+#include "cohort.h"
+#include "columns.h"
+#include "io.h"
+#include "num.h"
+#include "pipeline.h"
+#include "pool.h"
+
+/* -------------------- Allocation counting -------------------- */
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *p, size_t n);
+
+static atomic_size_t alloc_calls;
+
+void *__wrap_malloc(size_t n) {
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    return __real_malloc(n);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *p, size_t n) {
+    atomic_fetch_add_explicit(&alloc_calls, 1, memory_order_relaxed);
+    return __real_realloc(p, n);
+}
+
+/* -------------------- Options -------------------- */
+
+typedef struct {
+    size_t modules;
+    size_t components;   // per module
+    size_t group_size;   // members per best-of group; 0 = no groups
+    size_t students;     // cohort rows per component
+    double quote;        // fraction of component names needing quotes
+    double marked;       // fraction of components with a mark
+    int reps;            // timings keep the fastest of this many runs
+    const char *dir;
+    const char *out;
+} BenchOptions;
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--modules N] [--components N] [--group N] [--students N]\n"
+            "          [--quote F] [--marked F] [--reps N] [--dir DIR] [--out FILE]\n",
+            argv0);
+}
+
+static int parse_options(int argc, char **argv, BenchOptions *o) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!v) return 0;
+        if (strcmp(a, "--modules") == 0) o->modules = strtoul(v, NULL, 10);
+        else if (strcmp(a, "--components") == 0) o->components = strtoul(v, NULL, 10);
+        else if (strcmp(a, "--group") == 0) o->group_size = strtoul(v, NULL, 10);
+        else if (strcmp(a, "--students") == 0) o->students = strtoul(v, NULL, 10);
+        else if (strcmp(a, "--quote") == 0) o->quote = strtod(v, NULL);
+        else if (strcmp(a, "--marked") == 0) o->marked = strtod(v, NULL);
+        else if (strcmp(a, "--reps") == 0) o->reps = atoi(v);
+        else if (strcmp(a, "--dir") == 0) o->dir = v;
+        else if (strcmp(a, "--out") == 0) o->out = v;
+        else return 0;
+        i++;
+    }
+    return o->modules > 0 && o->components > 0 && o->reps > 0;
+}
+
+/* -------------------- Generator -------------------- */
+
+// xorshift64*: the data set depends only on the options
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_unit(void) {
+    return (double)(rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void path_in(char *buf, size_t len, const char *dir, const char *name) {
+    snprintf(buf, len, "%s/%s", dir, name);
+}
+
+// Whether component j of module i gets a name with a comma in it; a hash
+// rather than the generator so every file agrees without storing it
+static int needs_quote(size_t i, size_t j, double quote) {
+    uint64_t h = ((uint64_t)i << 32 | j) * 0x9E3779B97F4A7C15ULL;
+    return (double)(h >> 11) * (1.0 / 9007199254740992.0) < quote;
+}
+
+static void component_name(char *buf, size_t len, size_t j, int quoted) {
+    if (quoted) snprintf(buf, len, "\"Part %zu, \"\"extended\"\"\"", j);
+    else snprintf(buf, len, "Part %zu", j);
+}
+
+static int generate(const BenchOptions *o) {
+    char path[4096];
+    mkdir(o->dir, 0777);
+
+    path_in(path, sizeof path, o->dir, "modules.csv");
+    FILE *mf = fopen(path, "w");
+    path_in(path, sizeof path, o->dir, "components.csv");
+    FILE *cf = fopen(path, "w");
+    path_in(path, sizeof path, o->dir, "marks.csv");
+    FILE *kf = fopen(path, "w");
+    path_in(path, sizeof path, o->dir, "cohort.csv");
+    FILE *sf = fopen(path, "w");
+    path_in(path, sizeof path, o->dir, "cohort_ids.csv");
+    FILE *xf = fopen(path, "w");
+    if (!mf || !cf || !kf || !sf || !xf) {
+        fprintf(stderr, "Cannot write the data set under %s\n", o->dir);
+        if (mf) fclose(mf);
+        if (cf) fclose(cf);
+        if (kf) fclose(kf);
+        if (sf) fclose(sf);
+        if (xf) fclose(xf);
+        return 0;
+    }
+
+    fprintf(mf, "module_id,code,title,credits\n");
+    fprintf(cf, "module_id,component_name,weight,group_id,best_of\n");
+    fprintf(kf, "module_id,component_name,mark\n");
+    fprintf(sf, "student_id,module_id,component_name,mark\n");
+    fprintf(xf, "student_id,component_id,mark\n");   // tagged by tag_cohort_ids
+
+    char name[128];
+    for (size_t i = 0; i < o->modules; i++) {
+        int id = (int)i + 1;
+        fprintf(mf, "%d,MOD%05zu,Synthetic module %zu,%d\n", id, i, i, 10 + (int)(rng_next() % 3) * 5);
+
+        size_t grouped = o->group_size ? o->components / 3 : 0;
+        for (size_t j = 0; j < o->components; j++) {
+            component_name(name, sizeof name, j, needs_quote(i, j, o->quote));
+            if (j < grouped) {
+                // Best (size - 1) of each run of group_size members
+                size_t g = j / o->group_size;
+                size_t best = o->group_size > 1 ? o->group_size - 1 : 1;
+                fprintf(cf, "%d,%s,%.2f,%zu,%zu\n", id, name, 30.0 / (double)grouped, g + 1, best);
+            } else {
+                fprintf(cf, "%d,%s,%.2f,,\n", id, name, 70.0 / (double)(o->components - grouped));
+            }
+            if (rng_unit() < o->marked) fprintf(kf, "%d,%s,%.2f\n", id, name, rng_unit() * 100.0);
+            else fprintf(kf, "%d,%s,\n", id, name);
+        }
+    }
+
+    // Cohort: students in order, with marks in the first few modules. The
+    // same rows go to cohort_ids.csv by component id: every module has
+    // o->components components, so component j of module i is i * components + j.
+    size_t cohort_modules = o->modules < 8 ? o->modules : 8;
+    for (size_t s = 0; s < o->students; s++) {
+        for (size_t i = 0; i < cohort_modules; i++) {
+            for (size_t j = 0; j < o->components; j++) {
+                if (rng_unit() >= o->marked) continue;
+                component_name(name, sizeof name, j, needs_quote(i, j, o->quote));
+                double mark = rng_unit() * 100.0;
+                fprintf(sf, "S%07zu,%zu,%s,%.2f\n", s, i + 1, name, mark);
+                fprintf(xf, "S%07zu,%zu,%.2f\n", s, i * o->components + j, mark);
+            }
+        }
+    }
+
+    int ok = !ferror(mf) && !ferror(cf) && !ferror(kf) && !ferror(sf) && !ferror(xf);
+    ok &= fclose(mf) == 0;
+    ok &= fclose(cf) == 0;
+    ok &= fclose(kf) == 0;
+    ok &= fclose(sf) == 0;
+    ok &= fclose(xf) == 0;
+    if (!ok) fprintf(stderr, "Failed writing the data set under %s\n", o->dir);
+    return ok;
+}
+
+/* -------------------- Timing and reporting -------------------- */
+
+typedef struct {
+    const char *name;
+    double seconds;      // fastest run
+    size_t items;        // rows, modules, ... per run
+    size_t bytes;        // input or output bytes per run, 0 if n/a
+    size_t allocs;       // allocator calls in the fastest run
+} BenchResult;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static size_t file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+static char *slurp(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    size_t cap = file_size(path);
+    char *buf = malloc(cap + 1);
+    *len = buf ? fread(buf, 1, cap, fp) : 0;
+    fclose(fp);
+    return buf;
+}
+
+// The id-format header names the dictionary, which is only known once the
+// generated schema is loaded: rewrite cohort_ids.csv with it.
+static int tag_cohort_ids(const char *path, const ModuleList *list) {
+    size_t len = 0;
+    char *text = slurp(path, &len);
+    if (!text) return 0;
+    char *body = memchr(text, '\n', len);
+    size_t skip = body ? (size_t)(body - text) + 1 : len;
+
+    char tag[DICTIONARY_TAG_MAX];
+    module_list_dictionary_tag(list, tag);
+    FILE *fp = fopen(path, "wb");
+    int ok = fp != NULL;
+    if (ok) {
+        fprintf(fp, "student_id,component_id:%s,mark\n", tag);
+        ok = fwrite(text + skip, 1, len - skip, fp) == len - skip;
+        ok &= fclose(fp) == 0;
+    }
+    free(text);
+    return ok;
+}
+
+static FILE *results;
+
+static void report(const BenchResult *r) {
+    double rate = r->seconds > 0.0 ? (double)r->items / r->seconds : 0.0;
+    double mbs = r->seconds > 0.0 ? (double)r->bytes / r->seconds / 1e6 : 0.0;
+    double per = r->items ? (double)r->allocs / (double)r->items : 0.0;
+
+    char mb[32] = "";
+    if (r->bytes) snprintf(mb, sizeof mb, "%9.1f MB/s", mbs);
+
+    char line[256];
+    snprintf(line, sizeof line, "%-28s %10.4f s %14.0f items/s %14s %10zu allocs %8.3f /item\n",
+             r->name, r->seconds, rate, mb, r->allocs, per);
+    fputs(line, stdout);
+    if (results) fputs(line, results);
+}
+
+static void note(const char *fmt, ...) {
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof line, fmt, ap);
+    va_end(ap);
+    fputs(line, stdout);
+    if (results) fputs(line, results);
+}
+
+// Runs fn reps times and keeps the fastest; fn returns the item count
+typedef size_t (*BenchFn)(void *ctx);
+
+static BenchResult run(const char *name, int reps, size_t bytes, BenchFn fn, void *ctx) {
+    BenchResult best = { name, 0.0, 0, bytes, 0 };
+    for (int r = 0; r < reps; r++) {
+        size_t calls0 = atomic_load(&alloc_calls);
+        double t0 = now_sec();
+        size_t items = fn(ctx);
+        double t = now_sec() - t0;
+        size_t calls = atomic_load(&alloc_calls) - calls0;
+        if (r == 0 || t < best.seconds) {
+            best.seconds = t;
+            best.items = items;
+            best.allocs = calls;
+        }
+    }
+    report(&best);
+    return best;
+}
+
+/* -------------------- Benchmarks -------------------- */
+
+typedef struct {
+    const BenchOptions *o;
+    char modules[4096], components[4096], marks[4096], cohort[4096], cohort_ids[4096], saved[4096];
+    ModuleList list;     // loaded once for the calculator and writer
+    double *groups;      // random best-of inputs
+    double *work;
+    size_t group_count;
+    unsigned threads;
+} Bench;
+
+static size_t read_rows(const char *path, int view) {
+    CsvFile *f = csv_open_mmap(path);
+    if (!f) return 0;
+    CsvRow row;
+    size_t n = 0;
+    if (view) {
+        while (csv_read_row_view(f, &row) > 0) n++;
+    } else {
+        while (csv_read_row(f, &row) > 0) {
+            csv_row_free(&row);
+            n++;
+        }
+    }
+    csv_close(f);
+    return n;
+}
+
+static size_t b_read_row(void *ctx) { return read_rows(((Bench *)ctx)->marks, 0); }
+static size_t b_read_view(void *ctx) { return read_rows(((Bench *)ctx)->marks, 1); }
+
+// A fresh list sized the way main sizes it
+static void fresh_list(const Bench *b, ModuleList *list) {
+    size_t hint = module_list_arena_hint(csv_count_rows(b->modules), csv_count_rows(b->components));
+    if (!module_list_init_arena(list, hint)) module_list_init(list);
+}
+
+static size_t b_load_modules(void *ctx) {
+    Bench *b = ctx;
+    ModuleList list;
+    fresh_list(b, &list);
+    size_t n = load_modules(&list, b->modules) ? list.count : 0;
+    module_list_free(&list);
+    return n;
+}
+
+static size_t count_components(const ModuleList *list) {
+    size_t n = 0;
+    for (size_t i = 0; i < list->count; i++) n += list->items[i].component_count;
+    return n;
+}
+
+static size_t b_load_components(void *ctx) {
+    Bench *b = ctx;
+    ModuleList list;
+    fresh_list(b, &list);
+    size_t n = 0;
+    if (load_modules(&list, b->modules)) {
+        // Only the component load is meant to be timed, but a module table
+        // is its precondition; load_modules is well under 1% of it
+        if (load_components(&list, b->components)) n = count_components(&list);
+    }
+    module_list_free(&list);
+    return n;
+}
+
+static size_t b_load_marks(void *ctx) {
+    Bench *b = ctx;
+    return load_marks(&b->list, b->marks, b->threads) ? count_components(&b->list) : 0;
+}
+
+/* Streamed marks: the read/tokenize/resolve pipeline against the same work in one pass */
+
+typedef struct {
+    Bench *b;
+    char *text;          // header, then the marks rows repeated
+    size_t len;
+    size_t rows;
+    PipelineStats stats; // from the latest pipelined run
+} MarksStream;
+
+static size_t b_stream_serial(void *ctx) {
+    MarksStream *s = ctx;
+    CsvFile *f = csv_open_memory(s->text, s->len);
+    if (!f) return 0;
+    CsvRow row;
+    int first = 1;
+    while (csv_read_row_view(f, &row) > 0) {
+        if (first) { first = 0; continue; }
+        int id = 0;
+        double mark = 0.0;
+        if (row.count < 3 || !parse_int(row.fields[0], &id)) continue;
+        Module *m = module_list_find_by_id(&s->b->list, id);
+        Component *c = m ? module_find_component_by_name(m, row.fields[1]) : NULL;
+        if (c && parse_double(row.fields[2], &mark)) c->mark = mark;
+    }
+    csv_close(f);
+    return s->rows;
+}
+
+static size_t b_stream_pipeline(void *ctx) {
+    MarksStream *s = ctx;
+    FILE *in = fmemopen(s->text, s->len, "r");
+    if (!in) return 0;
+    char *header = NULL;
+    size_t cap = 0;
+    int ok = getline(&header, &cap, in) > 0 && pipeline_load_marks(&s->b->list, in, 0, &s->stats);
+    free(header);
+    fclose(in);
+    return ok ? s->rows : 0;
+}
+
+static void run_stream(Bench *b, size_t copies) {
+    MarksStream s;
+    memset(&s, 0, sizeof s);
+    s.b = b;
+
+    size_t len = 0;
+    char *marks = slurp(b->marks, &len);
+    const char *body = marks ? memchr(marks, '\n', len) : NULL;
+    if (body) {
+        size_t head = (size_t)(body - marks) + 1;
+        s.text = malloc(head + (len - head) * copies);
+        if (s.text) {
+            memcpy(s.text, marks, head);
+            s.len = head;
+            for (size_t k = 0; k < copies; k++, s.len += len - head)
+                memcpy(s.text + s.len, marks + head, len - head);
+            s.rows = (csv_count_rows(b->marks) - 1) * copies;
+
+            run("marks stream, one pass", b->o->reps, s.len, b_stream_serial, &s);
+            run("marks stream, pipelined", b->o->reps, s.len, b_stream_pipeline, &s);
+            pipeline_stats_print(&s.stats, stdout);
+            if (results) pipeline_stats_print(&s.stats, results);
+        }
+    }
+    free(s.text);
+    free(marks);
+}
+
+static size_t b_sums(void *ctx) {
+    Bench *b = ctx;
+    double total = 0.0;
+    const size_t passes = 20;
+    for (size_t p = 0; p < passes; p++) {
+        for (size_t i = 0; i < b->list.count; i++) {
+            double S, W, R;
+            module_sums_bestof(&b->list.items[i], &S, &W, &R);
+            total += S + W + R;
+        }
+    }
+    if (total < 0.0) fputc(' ', stderr);   // keep the loop observable
+    return passes * b->list.count;
+}
+
+static size_t b_save(void *ctx) {
+    Bench *b = ctx;
+    return save_marks_csv(&b->list, b->saved) ? count_components(&b->list) : 0;
+}
+
+// marks.csv as save_marks_csv writes it keeps two decimals
+static int same_saved_mark(double a, double b) {
+    if (a < 0.0 || b < 0.0) return a < 0.0 && b < 0.0;
+    return a - b < 0.005 && b - a < 0.005;
+}
+
+// Saves b->list, journals one edit to a name with a comma in it, loads both
+// back into a fresh list and counts the components whose mark came back
+// different (or missing). The generated names include quoted ones such as
+// Part 3, "extended". -1 if the round trip could not run at all.
+static long marks_roundtrip_check(Bench *b) {
+    Module *em = NULL;
+    Component *ec = NULL;
+    for (size_t i = 0; i < b->list.count && !ec; i++) {
+        Module *m = &b->list.items[i];
+        for (size_t j = 0; j < m->component_count && !ec; j++) {
+            if (strchr(m->components[j].name, ',')) {
+                em = m;
+                ec = &m->components[j];
+            }
+        }
+    }
+    if (!save_marks_csv(&b->list, b->saved)) return -1;
+    if (ec) {
+        ec->mark = 42.25;
+        if (!journal_append_mark(b->saved, em, ec)) return -1;
+    }
+
+    ModuleList back;
+    fresh_list(b, &back);
+    long bad = -1;
+    if (load_modules(&back, b->modules) && load_components(&back, b->components) &&
+        load_marks(&back, b->saved, b->threads) && back.count == b->list.count) {
+        bad = 0;
+        for (size_t i = 0; i < back.count; i++) {
+            const Module *m = &b->list.items[i];
+            const Module *r = &back.items[i];
+            for (size_t j = 0; j < m->component_count; j++) {
+                if (j >= r->component_count ||
+                    !same_saved_mark(m->components[j].mark, r->components[j].mark)) bad++;
+            }
+        }
+    }
+    module_list_free(&back);
+
+    char jpath[sizeof b->saved + 8];
+    snprintf(jpath, sizeof jpath, "%s.journal", b->saved);
+    remove(jpath);
+    return bad;
+}
+
+/* Scanner cross-check: the dispatched kernel must agree with the scalar one */
+
+typedef struct {
+    char *text;
+    size_t len;
+    size_t lines;
+    int mismatches;
+} ScanInput;
+
+static size_t scan_all(ScanInput *in, int scalar) {
+    ScanSpan spans_a[64], spans_b[64];
+    size_t total = 0;
+    const char *p = in->text, *end = in->text + in->len;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t n = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        size_t k = scalar ? scan_fields_scalar(p, n, spans_a, 64) : scan_fields(p, n, spans_a, 64);
+        if (in->mismatches >= 0) {
+            size_t k2 = scan_fields_scalar(p, n, spans_b, 64);
+            if (k != k2 || (k != SCAN_SLOW && memcmp(spans_a, spans_b, (k < 64 ? k : 64) * sizeof(ScanSpan))))
+                in->mismatches++;
+        }
+        total += (k == SCAN_SLOW) ? 0 : k;
+        p += n + 1;
+    }
+    return total;
+}
+
+static size_t b_scan_simd(void *ctx) {
+    ScanInput *in = ctx;
+    scan_all(in, 0);
+    return in->lines;
+}
+
+static size_t b_scan_scalar(void *ctx) {
+    ScanInput *in = ctx;
+    scan_all(in, 1);
+    return in->lines;
+}
+
+/* Scanner fuzz: random short lines through every kernel and both tokenizers */
+
+typedef struct {
+    size_t lines;
+    size_t kernels;      // SIMD kernels available to check
+    size_t kernel_bad;   // lines where one differs from scan_fields_scalar
+    size_t rows;
+    size_t row_bad;      // rows where a view reader differs from csv_read_row
+} ScanFuzz;
+
+// Block edges of both kernels, where a tail starts or a mask ends
+static const size_t SCAN_EDGES[] = { 0, 1, 2, 15, 16, 17, 31, 32, 33, 47, 48, 49, 63, 64, 65 };
+
+static uint64_t fuzz_next(uint64_t *st) {
+    uint64_t r = (*st += 0x9E3779B97F4A7C15ULL);
+    r = (r ^ (r >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    r = (r ^ (r >> 27)) * 0x94D049BB133111EBULL;
+    return r ^ (r >> 31);
+}
+
+// A line of commas, blanks of every isspace kind and text; one in four
+// may also hold the quotes and NULs that send it down the slow path.
+static size_t fuzz_line(uint64_t *st, char *out) {
+    static const char clean[] = "ab7.,,,,   \t\r\n\v\f";
+    uint64_t r = fuzz_next(st);
+    size_t len;
+    switch (r % 4) {
+    case 0:  len = SCAN_EDGES[(r >> 8) % (sizeof SCAN_EDGES / sizeof SCAN_EDGES[0])]; break;
+    case 1:  len = (size_t)(r >> 8) % 41; break;
+    default: len = (size_t)(r >> 8) % 200; break;
+    }
+    int dirty = (r >> 40) % 4 == 0;
+    for (size_t i = 0; i < len; i++) {
+        uint64_t b = fuzz_next(st);
+        if (dirty && b % 16 == 0) out[i] = (b >> 8) % 2 ? '"' : '\0';
+        else out[i] = clean[(b >> 8) % (sizeof clean - 1)];
+    }
+    return len;
+}
+
+static int same_rows(const CsvRow *a, const CsvRow *b) {
+    if (a->count != b->count) return 0;
+    for (size_t i = 0; i < a->count; i++) {
+        if (strcmp(a->fields[i], b->fields[i]) != 0) return 0;
+    }
+    return 1;
+}
+
+// Its own generator, like num_corpus, so the timed data does not move.
+// scratch is a file for the csv_open_copy reader, which splits in place.
+static void scan_fuzz(ScanFuzz *z, size_t lines, const char *scratch) {
+    static const char *const kernels[] = { "sse2", "avx2" };
+    memset(z, 0, sizeof *z);
+    uint64_t st = 0x2545F4914F6CDD1DULL;
+
+    ScanFieldsFn fns[2];
+    for (size_t k = 0; k < 2; k++) {
+        ScanFieldsFn fn = scan_fields_kernel(kernels[k]);
+        if (fn) fns[z->kernels++] = fn;
+    }
+
+    // Each line at every alignment in turn, with caps below and above its
+    // field count; spans past cap must be left alone (on SCAN_SLOW all of
+    // them are undefined)
+    char buf[32 + 256];
+    ScanSpan want[64], got[64];
+    for (size_t i = 0; i < lines; i++) {
+        char *line = buf + i % 32;
+        size_t len = fuzz_line(&st, line);
+        size_t cap = (size_t)fuzz_next(&st) % 8;
+        if (cap >= 5) cap = 64;
+
+        memset(want, 0xA5, sizeof want);
+        size_t n = scan_fields_scalar(line, len, want, cap);
+        int bad = 0;
+        for (size_t k = 0; k < z->kernels; k++) {
+            memset(got, 0xA5, sizeof got);
+            if (fns[k](line, len, got, cap) != n) bad = 1;
+            else if (n != SCAN_SLOW && memcmp(want, got, sizeof want) != 0) bad = 1;
+        }
+        if (bad) z->kernel_bad++;
+        z->lines++;
+    }
+
+    // Whole files of such lines, row by row through csv_read_row and the
+    // view over a copied line and in place; every other file lacks a
+    // final '\n'
+    char *text = malloc(1000 * 201);
+    if (!text) return;
+    for (size_t file = 0; file < lines / 1000; file++) {
+        size_t len = 0;
+        for (size_t i = 0; i < 1000; i++) {
+            len += fuzz_line(&st, text + len);
+            text[len++] = '\n';
+        }
+        if (file % 2) len--;
+
+        FILE *fp = fopen(scratch, "wb");
+        int written = fp && fwrite(text, 1, len, fp) == len;
+        if (fp && fclose(fp) != 0) written = 0;
+
+        CsvFile *ref = csv_open_memory(text, len);
+        CsvFile *view = csv_open_memory(text, len);
+        CsvFile *copy = written ? csv_open_copy(scratch) : NULL;
+        if (ref && view && copy) {
+            for (;;) {
+                CsvRow a = { 0 }, b = { 0 }, c = { 0 };
+                int ra = csv_read_row(ref, &a), rb = csv_read_row_view(view, &b);
+                int rc = csv_read_row_view(copy, &c);
+                if (ra != rb || ra != rc || (ra > 0 && (!same_rows(&a, &b) || !same_rows(&a, &c))))
+                    z->row_bad++;
+                if (ra > 0) csv_row_free(&a);
+                if (ra <= 0 || rb <= 0 || rc <= 0) break;
+                z->rows++;
+            }
+        } else {
+            z->row_bad++;
+        }
+        csv_close(ref);
+        csv_close(view);
+        csv_close(copy);
+    }
+    remove(scratch);
+    free(text);
+}
+
+/* Number parsing: parse_double/parse_int against the strtod/strtol they replaced */
+
+#define NUM_SLOT 40
+
+typedef struct {
+    char *text;          // count strings, NUM_SLOT bytes apart
+    size_t count;
+    size_t bytes;        // string bytes, for MB/s
+} NumCorpus;
+
+static int ref_parse_int(const char *s, int *out) {
+    if (!s || !*s) return 0;
+    char *end = NULL;
+    long v = strtol(s, &end, 10);
+    if (*end != '\0') return 0;
+    *out = (int)v;
+    return 1;
+}
+
+static int ref_parse_double(const char *s, double *out) {
+    if (!s || !*s) return 0;
+    char *end = NULL;
+    double v = strtod(s, &end);
+    if (*end != '\0') return 0;
+    *out = v;
+    return 1;
+}
+
+static const char *const NUM_ODD[] = {
+    "", ".", "-", "+", "5.", ".5", "-.5", "1e3", "2.5E-3", "inf", "-nan", " 7", "7 ",
+    "0x1A", "1,5", "-0", "+0.0", "00012.50", "9007199254740993", "9007199254740992.5",
+    "123456789012345678901234", "0.1234567890123456789012", "1.7976931348623157e308"
+};
+
+// Marks, weights and ids as the data files hold them; with mixed, also the
+// shapes that must take the library fallback. Its own generator, so the
+// rest of the run sees the same random data with or without this section.
+static int num_corpus(NumCorpus *c, size_t count, int mixed) {
+    c->text = malloc(count * NUM_SLOT);
+    if (!c->text) return 0;
+    c->count = count;
+    c->bytes = 0;
+
+    uint64_t st = 0xD1B54A32D192ED03ULL;
+    for (size_t i = 0; i < count; i++) {
+        st += 0x9E3779B97F4A7C15ULL;
+        uint64_t r = st;
+        r = (r ^ (r >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        r = (r ^ (r >> 27)) * 0x94D049BB133111EBULL;
+        r ^= r >> 31;
+        double u = (double)(r >> 11) * (1.0 / 9007199254740992.0);
+
+        char *s = c->text + i * NUM_SLOT;
+        switch (mixed ? r % 8 : r % 3) {
+        case 0: snprintf(s, NUM_SLOT, "%.2f", u * 100.0); break;
+        case 1: snprintf(s, NUM_SLOT, "%.4f", u * 100.0); break;
+        case 2: snprintf(s, NUM_SLOT, "%d", (int)(u * 2e6) - 1000000); break;
+        case 3: snprintf(s, NUM_SLOT, "%.17g", (u - 0.5) * 1e12); break;
+        case 4: snprintf(s, NUM_SLOT, "%+.*f", (int)(r >> 60), u * 1e4); break;
+        case 5: {
+            size_t n = 1 + (r >> 8) % 26, dot = (r >> 16) % (n + 1);
+            size_t k = 0;
+            for (size_t d = 0; d < n; d++) {
+                if (d == dot && dot) s[k++] = '.';
+                s[k++] = (char)('0' + (r >> (d * 2 % 56)) % 10);
+            }
+            s[k] = '\0';
+            break;
+        }
+        case 6: snprintf(s, NUM_SLOT, "%llu", (unsigned long long)(r >> (r % 40))); break;
+        default: snprintf(s, NUM_SLOT, "%s", NUM_ODD[(r >> 8) % (sizeof NUM_ODD / sizeof NUM_ODD[0])]); break;
+        }
+        c->bytes += strlen(s);
+    }
+    return 1;
+}
+
+// Mismatching results (status, or the exact bits of the value) on the corpus
+static size_t num_check(const NumCorpus *c) {
+    size_t bad = 0;
+    for (size_t i = 0; i < c->count; i++) {
+        const char *s = c->text + i * NUM_SLOT;
+        double a = 0.0, b = 0.0;
+        int ra = parse_double(s, &a), rb = ref_parse_double(s, &b);
+        if (ra != rb || (ra && memcmp(&a, &b, sizeof a) != 0)) bad++;
+
+        int x = 0, y = 0;
+        ra = parse_int(s, &x);
+        rb = ref_parse_int(s, &y);
+        if (ra != rb || (ra && x != y)) bad++;
+    }
+    return bad;
+}
+
+static size_t num_run(const NumCorpus *c, int which) {
+    double dsum = 0.0;
+    long isum = 0;
+    for (size_t i = 0; i < c->count; i++) {
+        const char *s = c->text + i * NUM_SLOT;
+        double d = 0.0;
+        int v = 0;
+        switch (which) {
+        case 0: if (parse_double(s, &d)) dsum += d; break;
+        case 1: if (ref_parse_double(s, &d)) dsum += d; break;
+        case 2: if (parse_int(s, &v)) isum += v; break;
+        default: if (ref_parse_int(s, &v)) isum += v; break;
+        }
+    }
+    if (dsum == 1.0 && isum == 1) fputc(' ', stderr);
+    return c->count;
+}
+
+static size_t b_parse_double(void *ctx) { return num_run(ctx, 0); }
+static size_t b_strtod(void *ctx) { return num_run(ctx, 1); }
+static size_t b_parse_int(void *ctx) { return num_run(ctx, 2); }
+static size_t b_strtol(void *ctx) { return num_run(ctx, 3); }
+
+/* Best-of selection: top_k_desc against the qsort it replaced */
+
+static int cmp_desc(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x < y) - (x > y);
+}
+
+#define GROUP_N 12
+#define GROUP_K 4
+
+static size_t b_topk(void *ctx) {
+    Bench *b = ctx;
+    double total = 0.0;
+    for (size_t g = 0; g < b->group_count; g++) {
+        memcpy(b->work, b->groups + g * GROUP_N, GROUP_N * sizeof(double));
+        top_k_desc(b->work, GROUP_N, GROUP_K);
+        for (int k = 0; k < GROUP_K; k++) total += b->work[k];
+    }
+    if (total < 0.0) fputc(' ', stderr);
+    return b->group_count;
+}
+
+static size_t b_qsort(void *ctx) {
+    Bench *b = ctx;
+    double total = 0.0;
+    for (size_t g = 0; g < b->group_count; g++) {
+        memcpy(b->work, b->groups + g * GROUP_N, GROUP_N * sizeof(double));
+        qsort(b->work, GROUP_N, sizeof(double), cmp_desc);
+        for (int k = 0; k < GROUP_K; k++) total += b->work[k];
+    }
+    if (total < 0.0) fputc(' ', stderr);
+    return b->group_count;
+}
+
+// Arrays of 0..70, 200 and 1000 marks (ties and unset -1s included) with
+// k from 0 to past n, through top_k_desc and qsort. A result is bad if its
+// prefix differs or the array stopped being a permutation of its input.
+static size_t topk_check(size_t cases) {
+    double a[1000], ref[1000];
+    size_t bad = 0;
+    uint64_t st = 0x8CB92BA72F3D8DD7ULL;
+    for (size_t t = 0; t < cases; t++) {
+        uint64_t r = fuzz_next(&st);
+        size_t n = (r % 16 == 0) ? ((r >> 4) % 2 ? 1000 : 200) : (size_t)(r >> 8) % 71;
+        size_t k = (size_t)(r >> 20) % (n + 3);
+        if ((r >> 40) % 2) k %= 9;   // the small-k window as often as not
+        for (size_t i = 0; i < n; i++) {
+            uint64_t v = fuzz_next(&st);
+            if (v % 8 == 0) a[i] = -1.0;
+            else if (v % 2) a[i] = (double)((v >> 8) % 21) * 5.0;
+            else a[i] = (double)(v >> 11) * (100.0 / 9007199254740992.0);
+        }
+        memcpy(ref, a, n * sizeof(double));
+        qsort(ref, n, sizeof(double), cmp_desc);
+
+        top_k_desc(a, n, k);
+        size_t m = k < n ? k : n;
+        int ok = memcmp(a, ref, m * sizeof(double)) == 0;
+        qsort(a, n, sizeof(double), cmp_desc);
+        if (!ok || memcmp(a, ref, n * sizeof(double)) != 0) bad++;
+    }
+    return bad;
+}
+
+// columns_plain_sums against module_sums_plain for every module of list,
+// over rounds of random marks (a quarter unset) in the cohort row layout.
+// The two must agree bit for bit; returns the modules that do not.
+static size_t columns_check(const ModuleList *list, size_t rounds) {
+    ComponentColumns cc;
+    if (!columns_build(&cc, list)) return (size_t)-1;
+    double *marks = malloc((cc.count ? cc.count : 1) * sizeof(double));
+    if (!marks) {
+        columns_free(&cc);
+        return (size_t)-1;
+    }
+
+    size_t bad = 0;
+    uint64_t st = 0x3C6EF372FE94F82BULL;
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t j = 0; j < cc.count; j++) {
+            uint64_t v = fuzz_next(&st);
+            marks[j] = (v % 4 == 0) ? -1.0 : (double)(v >> 11) * (100.0 / 9007199254740992.0);
+        }
+        for (size_t i = 0; i < list->count; i++) {
+            ModuleSums a, b;
+            size_t at = cc.module_offset[i];
+            columns_plain_sums(&cc, marks, at, cc.module_offset[i + 1], &a);
+            module_sums_plain(&list->items[i], marks + at, &b);
+            if (memcmp(&a, &b, sizeof a) != 0) bad++;
+        }
+    }
+    free(marks);
+    columns_free(&cc);
+    return bad;
+}
+
+/* Cohort evaluation at a given thread count */
+
+typedef struct {
+    Cohort *cohort;
+    unsigned threads;
+} CohortRun;
+
+static size_t b_cohort_eval(void *ctx) {
+    CohortRun *r = ctx;
+    ModuleSums *sums = cohort_evaluate(r->cohort, r->threads);
+    free(sums);
+    return r->cohort->student_count * r->cohort->schema->count;
+}
+
+typedef struct {
+    Bench *b;
+    const char *path;
+    size_t rows;
+    unsigned threads;
+} CohortLoad;
+
+static size_t b_cohort_load(void *ctx) {
+    CohortLoad *r = ctx;
+    Cohort cohort;
+    if (!cohort_init(&cohort, &r->b->list)) return 0;
+    int ok = load_cohort_marks(&cohort, r->path, r->threads);
+    cohort_free(&cohort);
+    return ok ? r->rows : 0;
+}
+
+// Runs fn at 1, 2, 4, ... threads, ending on all of them; *threads is
+// the count fn reads from ctx
+static void thread_sweep(Bench *b, const char *label, size_t bytes, BenchFn fn, void *ctx, unsigned *threads) {
+    char names[32][48];
+    double base = 0.0;
+    unsigned t = 1;
+    for (int k = 0; k < 32; k++) {
+        snprintf(names[k], sizeof names[k], "%s x%u", label, t);
+        *threads = t;
+        BenchResult res = run(names[k], b->o->reps, bytes, fn, ctx);
+        if (t == 1) base = res.seconds;
+        else if (res.seconds > 0.0) note("  %s speedup %.2fx\n", names[k], base / res.seconds);
+        if (t == b->threads) break;
+        t = (t * 2 > b->threads) ? b->threads : t * 2;
+    }
+}
+
+static void run_cohort(Bench *b) {
+    CohortLoad load = { b, b->cohort, csv_count_rows(b->cohort) - 1, 1 };
+    thread_sweep(b, "load_cohort_marks", file_size(b->cohort), b_cohort_load, &load, &load.threads);
+
+    // The same rows by component id: no name column to split or look up
+    CohortLoad by_id = { b, b->cohort_ids, load.rows, 1 };
+    run("load_cohort_marks by id x1", b->o->reps, file_size(b->cohort_ids), b_cohort_load, &by_id);
+    note("  cohort file %zu bytes by name, %zu by id\n", file_size(b->cohort), file_size(b->cohort_ids));
+
+    Cohort cohort;
+    if (!cohort_init(&cohort, &b->list)) return;
+    if (!load_cohort_marks(&cohort, b->cohort, b->threads)) {
+        cohort_free(&cohort);
+        return;
+    }
+
+    CohortRun r = { &cohort, 1 };
+    thread_sweep(b, "cohort_evaluate", 0, b_cohort_eval, &r, &r.threads);
+    cohort_free(&cohort);
+}
+
+int main(int argc, char **argv) {
+    BenchOptions o = { 500, 24, 4, 2000, 0.1, 0.6, 3, "bench/data", "bench/results.txt" };
+    if (!parse_options(argc, argv, &o)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Bench b;
+    memset(&b, 0, sizeof b);
+    b.o = &o;
+    b.threads = pool_default_threads();
+    path_in(b.modules, sizeof b.modules, o.dir, "modules.csv");
+    path_in(b.components, sizeof b.components, o.dir, "components.csv");
+    path_in(b.marks, sizeof b.marks, o.dir, "marks.csv");
+    path_in(b.cohort, sizeof b.cohort, o.dir, "cohort.csv");
+    path_in(b.cohort_ids, sizeof b.cohort_ids, o.dir, "cohort_ids.csv");
+    path_in(b.saved, sizeof b.saved, o.dir, "marks_saved.csv");
+
+    if (!generate(&o)) return 1;
+
+    results = fopen(o.out, "a");
+    if (!results) fprintf(stderr, "Warning: cannot append to %s\n", o.out);
+
+    char header[512];
+    time_t now = time(NULL);
+    char stamp[64];
+    strftime(stamp, sizeof stamp, "%Y-%m-%d %H:%M:%S", localtime(&now));
+    snprintf(header, sizeof header,
+             "\n== %s  modules=%zu components=%zu group=%zu students=%zu quote=%.2f marked=%.2f reps=%d threads=%u\n",
+             stamp, o.modules, o.components, o.group_size, o.students, o.quote, o.marked, o.reps, b.threads);
+    fputs(header, stdout);
+    if (results) fputs(header, results);
+
+    size_t marks_bytes = file_size(b.marks);
+    run("csv_read_row", o.reps, marks_bytes, b_read_row, &b);
+    run("csv_read_row_view", o.reps, marks_bytes, b_read_view, &b);
+
+    ScanInput scan = { NULL, 0, 0, -1 };
+    scan.text = slurp(b.marks, &scan.len);
+    if (scan.text) {
+        scan.lines = csv_count_rows(b.marks);
+        run("scan_fields", o.reps, scan.len, b_scan_simd, &scan);
+        run("scan_fields_scalar", o.reps, scan.len, b_scan_scalar, &scan);
+        scan.mismatches = 0;
+        scan_all(&scan, 0);
+        note("  scan_fields vs scalar: %d mismatching lines\n", scan.mismatches);
+        free(scan.text);
+    }
+
+    ScanFuzz fuzz;
+    char scratch[4096];
+    path_in(scratch, sizeof scratch, o.dir, "fuzz.csv");
+    scan_fuzz(&fuzz, 200000, scratch);
+    note("  scan_fields fuzz: %zu lines, %zu with a SIMD kernel (of %zu) off scalar\n",
+         fuzz.lines, fuzz.kernel_bad, fuzz.kernels);
+    note("  csv_read_row_view fuzz (copied and in place): %zu rows, %zu off csv_read_row\n",
+         fuzz.rows, fuzz.row_bad);
+
+    NumCorpus nums;
+    if (num_corpus(&nums, (size_t)1 << 20, 0)) {
+        run("parse_double", o.reps, nums.bytes, b_parse_double, &nums);
+        run("strtod", o.reps, nums.bytes, b_strtod, &nums);
+        run("parse_int", o.reps, nums.bytes, b_parse_int, &nums);
+        run("strtol", o.reps, nums.bytes, b_strtol, &nums);
+        free(nums.text);
+    }
+    if (num_corpus(&nums, (size_t)1 << 22, 1)) {
+        note("  parse_double/parse_int vs strtod/strtol: %zu mismatches in %zu strings\n",
+             num_check(&nums), nums.count);
+        free(nums.text);
+    }
+
+    run("load_modules", o.reps, file_size(b.modules), b_load_modules, &b);
+    run("load_components", o.reps, file_size(b.components), b_load_components, &b);
+
+    fresh_list(&b, &b.list);
+    if (!load_modules(&b.list, b.modules) || !load_components(&b.list, b.components)) {
+        fprintf(stderr, "Failed to load the generated data set\n");
+        return 1;
+    }
+    if (!tag_cohort_ids(b.cohort_ids, &b.list)) {
+        fprintf(stderr, "Failed to write %s\n", b.cohort_ids);
+        return 1;
+    }
+    run("load_marks", o.reps, marks_bytes, b_load_marks, &b);
+    run_stream(&b, 20);
+    run("module_sums_bestof", o.reps, 0, b_sums, &b);
+    note("  columns_plain_sums vs module_sums_plain: %zu modules differ in %zu\n",
+         columns_check(&b.list, 20), 20 * b.list.count);
+
+    // save_marks_csv fsyncs, so its figure includes the disk flush. The
+    // output size is known once the first save has run.
+    b_save(&b);
+    run("save_marks_csv", o.reps, file_size(b.saved), b_save, &b);
+    note("  save_marks_csv + journal round trip: %ld marks off (quoted names included)\n",
+         marks_roundtrip_check(&b));
+
+    b.group_count = 200000;
+    b.groups = malloc(b.group_count * GROUP_N * sizeof(double));
+    b.work = malloc(GROUP_N * sizeof(double));
+    if (b.groups && b.work) {
+        for (size_t i = 0; i < b.group_count * GROUP_N; i++) b.groups[i] = rng_unit() * 100.0;
+        run("top_k_desc (4 of 12)", o.reps, 0, b_topk, &b);
+        run("qsort (4 of 12)", o.reps, 0, b_qsort, &b);
+        note("  top_k_desc vs qsort: %zu bad of 100000 (n up to 1000, all k)\n", topk_check(100000));
+    }
+    free(b.groups);
+    free(b.work);
+
+    if (o.students > 0) run_cohort(&b);
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    note("peak RSS %ld KiB\n", ru.ru_maxrss);
+    note("allocator calls in total %zu\n", (size_t)atomic_load(&alloc_calls));
+
+    module_list_free(&b.list);
+    if (results) fclose(results);
+    return 0;
+}
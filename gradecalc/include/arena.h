@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator: allocations are carved from large blocks and are only
+// released all together by arena_free.
+typedef struct {
+    ArenaBlock *head;      // current block; older blocks chain behind it
+    size_t next_size;      // size of the next block to request
+    size_t blocks;         // blocks obtained from malloc
+    size_t bytes;          // bytes handed out
+} Arena;
+
+void  arena_init(Arena *a, size_t first_block);
+void *arena_alloc(Arena *a, size_t size);
+
+// Grows an allocation. The last allocation of the current block is
+// extended in place when there is room; otherwise the data is copied and
+// the old space stays unused until arena_free.
+void *arena_realloc(Arena *a, void *p, size_t old_size, size_t new_size);
+
+void  arena_free(Arena *a);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+
+#include "grades.h"
+#include "calc.h"
+
+// Cached evaluation of one module, split the way module_sums_bestof adds
+// it up: ungrouped components, then each best-of group.
+typedef struct {
+    ModuleSums total;
+    ModuleSums plain;
+    ModuleSums *group;           // one per ComponentGroup
+    unsigned char *group_dirty;
+    int plain_dirty;
+    int dirty;                   // some part above is stale
+} ModuleCache;
+
+// Per-module sums and credit-weighted totals for the interactive report.
+// After a mark edit only the affected part of one module is re-evaluated;
+// the overall totals are then re-added from the cached module totals.
+typedef struct {
+    const ModuleList *modules;
+    ModuleCache *mods;
+    OverallSums overall;
+    double *scratch;             // room for the largest group's marks
+} ReportCache;
+
+// Evaluates everything once; builds missing group tables.
+int  report_cache_init(ReportCache *rc, ModuleList *modules);
+void report_cache_free(ReportCache *rc);
+
+// Records that the mark of m->components[component] changed.
+void report_cache_mark_dirty(ReportCache *rc, const Module *m, size_t component);
+
+// Re-evaluates whatever is dirty and rebuilds rc->overall from the modules.
+void report_cache_refresh(ReportCache *rc);
+
+const ModuleSums *report_cache_module(const ReportCache *rc, size_t module_index);
+
+#endif
@@ -3,10 +3,61 @@
 
 #include "grades.h"
 
+typedef struct {
+    double S, W, R;
+} ModuleSums;
+
 // Computes weighted sums with optional best-of grouping.
 // S = Σ(mark * weight) over counted items
 // W = Σ(weight) over marked items that count
 // R = Σ(weight) over remaining items that count
-void module_sums_bestof(const Module *m, double *outS, double *outW, double *outR);
+// Returns 0, with all three zeroed, when out of memory for the scratch of
+// a large group or for a group table the module does not have yet.
+int module_sums_bestof(const Module *m, double *outS, double *outW, double *outR);
+
+// Same, but marks[i] replaces m->components[i].mark (-1 if unknown).
+// Used to evaluate other students' marks against a shared schema.
+int module_sums_bestof_marks(const Module *m, const double *marks,
+                             double *outS, double *outW, double *outR);
+
+// The two halves of module_sums_bestof_marks; both need the group table
+// from module_build_groups. marks may be NULL to use the components' own.
+// module_sums_group needs scratch room for m->max_group_size marks.
+void module_sums_plain(const Module *m, const double *marks, ModuleSums *out);
+void module_sums_group(const Module *m, size_t g, const double *marks,
+                       double *scratch, ModuleSums *out);
+
+// Smallest mark needed on the unmarked members of best-of group g for the
+// module (with sums total) to reach target, other remaining work scoring
+// assume_other: uniform is the same mark on every unmarked member, single
+// the mark on just one of them with the rest at assume_other. -INFINITY
+// means already safe. Returns 0 (nothing to solve) when the group has no
+// unmarked member or a non-positive weight. scratch as for
+// module_sums_group.
+typedef struct {
+    size_t remaining;
+    double uniform;
+    double single;
+} GroupRequired;
+
+int module_group_required(const Module *m, size_t g, const double *marks,
+                          const ModuleSums *total, double target, double assume_other,
+                          double *scratch, GroupRequired *out);
+
+// Moves the k largest of a[0..n) to a[0..k), sorted descending; the
+// order of the rest is unspecified. Replaces a full qsort for best-of-N.
+void top_k_desc(double *a, size_t n, size_t k);
+
+// Running credit-weighted totals behind the overall summary.
+typedef struct {
+    double total_credits;
+    double A;         // Σ credits * earned contribution (S / 100)
+    double B;         // Σ credits * remaining weight (R / 100)
+    double credit_S;  // Σ credits * S
+    double credit_W;  // Σ credits * W
+} OverallSums;
+
+void overall_init(OverallSums *o);
+void overall_add(OverallSums *o, int credits, double S, double W, double R);
 
 #endif
@@ -0,0 +1,67 @@
+#ifndef COHORT_H
+#define COHORT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "grades.h"
+#include "config.h"
+#include "calc.h"
+#include "columns.h"
+#include "report.h"
+
+// Many students' marks against one loaded module/component schema.
+// marks is a dense student_count × column_count matrix (-1 = unset);
+// module i owns columns [module_offset[i], module_offset[i] + component_count).
+typedef struct {
+    ModuleList *schema;
+    size_t *module_offset;
+    size_t column_count;
+
+    char **student_ids;
+    double *marks;
+    size_t student_count;
+    size_t student_capacity;
+
+    // Open-addressing index on student id: slot holds index + 1, 0 = empty
+    size_t *id_slots;
+    size_t id_cap;
+} Cohort;
+
+int  cohort_init(Cohort *c, ModuleList *schema);
+void cohort_free(Cohort *c);
+
+// Returns the row index for a student id, adding a blank row if it is new.
+// Returns -1 if out of memory.
+long cohort_student(Cohort *c, const char *student_id);
+
+double *cohort_row(const Cohort *c, size_t student);
+size_t  cohort_column(const Cohort *c, const Module *m, const Component *comp);
+
+// Evaluates every (student, module) pair across nthreads workers into
+// sums[student * schema->count + module]. Each pair is written by exactly
+// one task, so the result does not depend on the thread count.
+// Returns a malloc'd array, or NULL if out of memory.
+ModuleSums *cohort_evaluate(const Cohort *c, unsigned nthreads);
+
+// Building blocks shared with the streaming report: build missing group
+// tables (reporting the largest group), then evaluate module i of one
+// student's marks row. scratch holds max_group_size marks.
+int  cohort_prepare_schema(ModuleList *schema, size_t *max_group_size);
+void cohort_eval_module(const ModuleList *schema, const ComponentColumns *cols, size_t i,
+                        const double *row, double *scratch, ModuleSums *out);
+
+// Writes one CSV line per student and module plus an OVERALL line per
+// student, with the figures show_report prints for a single student.
+// Fields are quoted as needed; figures without a denominator are empty.
+int  cohort_report_csv(const Cohort *c, const ModuleSums *sums, const Config *cfg, FILE *out);
+void cohort_write_header(OutBuf *ob);
+void cohort_write_student(OutBuf *ob, const ModuleList *modules, const char *sid,
+                          const ModuleSums *ms, const Config *cfg);
+
+// One CSV line per student and unfinished best-of group: the mark needed
+// on each remaining item, and on one item with the rest at assume_other
+// (module_group_required). Needs the sums from cohort_evaluate.
+int cohort_group_report_csv(const Cohort *c, const ModuleSums *sums, const Config *cfg, FILE *out);
+
+#endif
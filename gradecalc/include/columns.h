@@ -0,0 +1,31 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <stddef.h>
+
+#include "grades.h"
+#include "calc.h"
+
+// Struct-of-arrays copy of every component in a ModuleList, in module
+// order. Module i owns columns [module_offset[i], module_offset[i + 1]),
+// the same numbering as a Cohort row.
+typedef struct {
+    size_t count;
+    size_t module_count;
+    size_t *module_offset;
+
+    double *weight;
+    double *plain;        // 1.0 for an ungrouped component, else 0.0
+} ComponentColumns;
+
+// Needs the group tables from module_list_build_groups.
+int  columns_build(ComponentColumns *cc, const ModuleList *modules);
+void columns_free(ComponentColumns *cc);
+
+// S/W/R over the ungrouped components in columns [begin, end), reading
+// marks[begin..end). Branch-free; SSE2 two lanes at a time when available,
+// summed in column order so the result equals module_sums_plain's.
+void columns_plain_sums(const ComponentColumns *cc, const double *marks,
+                        size_t begin, size_t end, ModuleSums *out);
+
+#endif
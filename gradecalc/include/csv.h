@@ -2,6 +2,7 @@
 #define CSV_H
 
 #include <stddef.h>
+#include <stdio.h>
 
 typedef struct {
     char **fields;
@@ -11,11 +12,53 @@ typedef struct {
 typedef struct CsvFile CsvFile;
 
 CsvFile *csv_open(const char *path);
+
+// Maps a regular file into memory and reads rows from the mapping; the
+// quoting rules are the same as csv_open. Pipes, FIFOs and empty files
+// fall back to stdio, and "-" reads from stdin.
+CsvFile *csv_open_mmap(const char *path);
 void     csv_close(CsvFile *f);
 
+// Reads all of path through stdio into a private buffer and parses that,
+// for files another program may be rewriting: a mapping of a file that
+// is truncated under it faults on access.
+CsvFile *csv_open_copy(const char *path);
+
+// Number of lines in a regular file, for sizing allocations up front;
+// 0 if the file cannot be mapped.
+size_t   csv_count_rows(const char *path);
+
+// Lines left to read in an open file; 0 on the stdio path.
+size_t   csv_count_lines(const CsvFile *f);
+
+// Splitting a mapped file for parallel parsing. A record never spans a
+// line (a quoted field ends at the end of its line), so any line start is
+// a record boundary. csv_mapped_size is 0 on the stdio path; csv_tell is
+// the offset of the next unread line; csv_line_start is the first unread
+// line start at or after pos (the size at the end).
+size_t   csv_mapped_size(const CsvFile *f);
+size_t   csv_tell(const CsvFile *f);
+size_t   csv_line_start(const CsvFile *f, size_t pos);
+
+// Reader over bytes [begin, end) of f's mapping, both line starts. The
+// slice shares the mapping, so f must stay open until it is closed.
+CsvFile *csv_open_slice(const CsvFile *f, size_t begin, size_t end);
+
+// Reader over len bytes of whole lines in memory, which must outlive it.
+CsvFile *csv_open_memory(const char *data, size_t len);
+
+// The stream a file opened with csv_open_mmap reads through when it could
+// not be mapped (pipes, FIFOs, stdin); NULL for a mapped file.
+FILE    *csv_stream(const CsvFile *f);
+
 // Reads next row. Returns 1 if row read, 0 on EOF, -1 on error.
 int      csv_read_row(CsvFile *f, CsvRow *out);
 
+// Reads next row without allocating per field. The fields point into the
+// file's own line buffer and are valid until the next read or csv_close;
+// do not pass such a row to csv_row_free. Returns 1/0/-1 as csv_read_row.
+int      csv_read_row_view(CsvFile *f, CsvRow *out);
+
 // Free memory owned by a row
 void     csv_row_free(CsvRow *row);
 
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+#include "arena.h"
+
 typedef struct {
     char name[64];
     double weight;
@@ -13,6 +15,15 @@ typedef struct {
     int best_of;   // 0 = normal; >0 = count only best N in the group
 } Component;
 
+// A best-of group: the components of one module sharing (group_id, best_of)
+typedef struct {
+    int group_id;
+    int best_of;
+    double item_weight;   // weight of the first member, counted per best mark
+    size_t first;         // component index of the first member
+    size_t member_start;  // members are group_members[member_start ..
+    size_t member_count;  //                         member_start + member_count)
+} ComponentGroup;
 
 typedef struct {
     int id;
@@ -23,20 +34,89 @@ typedef struct {
     Component *components;
     size_t component_count;
     size_t component_capacity;
+
+    // Open-addressing index on component name: slot holds index + 1, 0 = empty
+    size_t *name_slots;
+    size_t name_cap;
+
+    // Group table from module_build_groups; component_group is NULL until
+    // built and is dropped again by module_add_component.
+    int *component_group;      // per component: index into groups, -1 = ungrouped
+    ComponentGroup *groups;
+    size_t group_count;
+    size_t *group_members;     // component indices, contiguous per group
+    size_t max_group_size;
+
+    Arena *arena;              // the owning list's arena, NULL = malloc
 } Module;
 
+// Where a dense component id points
+typedef struct {
+    size_t module;      // index into ModuleList.items
+    size_t component;   // index into that module's components
+    int module_id;
+    int named;          // (module_id, name) looks this id up; 0 for a
+                        // repeated module id or name, which names never reach
+} ComponentRef;
+
 typedef struct {
     Module *items;
     size_t count;
     size_t capacity;
+
+    // Open-addressing index on module id: slot holds index + 1, 0 = empty.
+    // Stores indices rather than pointers so it survives items reallocs.
+    size_t *id_slots;
+    size_t id_cap;
+
+    // Component dictionary from module_list_index_components. Component
+    // ids are dense, counting modules in list order and components in load
+    // order within each (the cohort column order), and (module id, name)
+    // resolves to one in a single probe sequence. Slot holds id + 1.
+    ComponentRef *component_refs;
+    size_t component_total;
+    size_t *component_slots;
+    size_t component_cap;
+
+    // With an arena, all module, component, index and group storage is
+    // bump-allocated from it and module_list_free releases it in one go.
+    Arena *arena;
 } ModuleList;
 
 void module_list_init(ModuleList *list);
+
+// Arena-backed list; size_hint from module_list_arena_hint. Returns 0
+// (leaving a plain malloc-backed list) if the arena cannot be set up.
+int  module_list_init_arena(ModuleList *list, size_t size_hint);
+size_t module_list_arena_hint(size_t module_rows, size_t component_rows);
+
 void module_list_free(ModuleList *list);
 int  module_list_push(ModuleList *list, const Module *m);
 
+// Size storage and lookup tables for n entries up front, so loading from
+// a known row count does not grow by doubling.
+int  module_list_reserve(ModuleList *list, size_t n);
+int  module_reserve_components(Module *m, size_t n);
+
 Module *module_list_find_by_id(ModuleList *list, int id);
 Component *module_find_component_by_name(Module *m, const char *name);
 int module_add_component(Module *m, const Component *c);
 
+// Builds the component dictionary; call once components are loaded.
+// Lookups return -1 / NULL until it is built.
+int  module_list_index_components(ModuleList *list);
+long module_list_component_id(const ModuleList *list, int module_id, const char *name);
+Component *module_list_component(ModuleList *list, size_t id, Module **m);
+
+// "count:hash" naming the dictionary: the component count and an FNV-1a
+// hash of each "module_id,name" in id order. Files keyed by component id
+// carry it, so they are not applied after components.csv changes.
+#define DICTIONARY_TAG_MAX 40
+void module_list_dictionary_tag(const ModuleList *list, char tag[DICTIONARY_TAG_MAX]);
+
+// Builds the best-of group table; call once components are loaded.
+int  module_build_groups(Module *m);
+void module_free_groups(Module *m);
+int  module_list_build_groups(ModuleList *list);
+
 #endif
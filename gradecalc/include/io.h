@@ -2,10 +2,40 @@
 #define IO_H
 
 #include "grades.h"
+#include "cohort.h"
+#include "config.h"
+#include "mc.h"
+#include <stdio.h>
 
 int load_modules(ModuleList *modules, const char *path);
 int load_components(ModuleList *modules, const char *path);
-int load_marks(ModuleList *modules, const char *path);
+
+// Both schema files again into an empty list, for a live reload: they are
+// read from private copies rather than mapped, since another program may
+// be rewriting them.
+int reload_schema(ModuleList *modules, const char *modules_path, const char *components_path);
+
+// Files of a few MiB and up are split at line starts and parsed on
+// nthreads workers; the result is the same as a single pass.
+int load_marks(ModuleList *modules, const char *path, unsigned nthreads);
+// Reads path alone (no journal, and from a copy as reload_schema does)
+// into values[component id], leaving the entries of components the file
+// does not mention as they were. 0 if path cannot be read (unlike
+// load_marks, a missing file is an error here); an empty file is fine.
+int load_marks_values(ModuleList *modules, const char *path, double *values);
+int load_cohort_marks(Cohort *cohort, const char *path, unsigned nthreads);
+
+// Per-component mean and/or sd for the Monte Carlo estimator, from a CSV
+// with module_id, component_name, mean, sd; empty cells keep the default.
+int load_mc_priors(McPriors *priors, ModuleList *modules, const char *path);
+
+// Constant-memory alternative to load_cohort_marks + cohort_report_csv for
+// a marks file grouped by student_id; writes the same CSV to out.
+int stream_cohort_report(ModuleList *schema, const char *path, const Config *cfg, FILE *out);
 int save_marks_csv(const ModuleList *modules, const char *path);
 
+// Appends one edited mark to <path>.journal. load_marks replays the
+// journal over path, and save_marks_csv removes it once folded in.
+int journal_append_mark(const char *path, const Module *m, const Component *c);
+
 #endif
@@ -0,0 +1,72 @@
+#ifndef MC_H
+#define MC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <stdio.h>
+
+#include "grades.h"
+#include "config.h"
+#include "cohort.h"
+#include "report.h"
+
+// Where the mean of a sampled (unset) mark comes from when the priors
+// do not name one for that component.
+typedef enum {
+    MC_MEAN_ASSUME,   // Config.assume_other
+    MC_MEAN_STUDENT   // the student's credit-weighted average on marked work
+} McMeanSource;
+
+typedef struct {
+    size_t samples;
+    uint64_t seed;
+    double sd;            // spread of a sampled mark unless the priors say otherwise
+    McMeanSource mean;
+} McOptions;
+
+// Optional per-component distributions, flattened like the cohort columns:
+// component j of module i is entry module_offset[i] + j. NAN = use the
+// McOptions default for that component.
+typedef struct {
+    size_t *module_offset;
+    double *mean;
+    double *sd;
+    size_t count;
+} McPriors;
+
+int  mc_priors_init(McPriors *p, const ModuleList *modules);
+void mc_priors_free(McPriors *p);
+
+#define MC_PERCENTILES 5   // 5th, 25th, 50th, 75th, 95th
+
+// Distribution of the final credit-weighted overall mark once every unset
+// mark is drawn from Normal(mean, sd) clamped to [0, 100].
+typedef struct {
+    size_t samples;
+    double p_target;                  // fraction with overall >= target
+    double mean;
+    double percentile[MC_PERCENTILES];  // to the nearest 0.01
+} McResult;
+
+extern const double MC_PERCENTILE_RANKS[MC_PERCENTILES];
+
+// Runs opts->samples draws on nthreads workers. Sample i always uses the
+// same random numbers (a counter-based generator keyed by seed, sample
+// and component), so the result does not depend on the thread count.
+// marks/module_offset give another student's marks as in the cohort
+// (NULL = the components' own); priors may be NULL. Builds missing
+// group tables. Returns 0 if out of memory.
+int mc_run(ModuleList *modules, const double *marks, const size_t *module_offset,
+           const McPriors *priors, const McOptions *opts, const Config *cfg,
+           unsigned nthreads, McResult *out);
+
+// One record of the mc_run figures for the loaded marks, or per student
+// of a cohort. The cohort report spreads students over the threads, each
+// worker refilling one model and histogram for student after student.
+int mc_report(ModuleList *modules, const McPriors *priors, const McOptions *opts,
+              const Config *cfg, unsigned nthreads, ReportFormat fmt, FILE *out);
+int mc_cohort_report(const Cohort *c, const McPriors *priors, const McOptions *opts,
+                     const Config *cfg, unsigned nthreads, ReportFormat fmt, FILE *out);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef NUM_H
+#define NUM_H
+
+#include <stddef.h>
+
+// Longest "%.2f" rendering of a double (DBL_MAX has 309 integer digits)
+#define FIXED2_TEXT_MAX 320
+
+// Writes v the way printf("%.2f") does and returns the length. buf needs
+// FIXED2_TEXT_MAX bytes.
+size_t format_fixed2(char *buf, double v);
+
+// Whole-string number parsing for CSV fields: 1 and *out set when all of s
+// is a number, 0 otherwise. Same results as strtol/strtod in the C locale;
+// the plain decimals the data files hold ("53.80", "-3", "1.5625") are
+// parsed without them, anything else falls back to the library.
+int parse_int(const char *s, int *out);
+int parse_double(const char *s, double *out);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "grades.h"
+
+// Marks ingest as three stages on their own threads, handing blocks of
+// whole lines along bounded single-producer/single-consumer rings:
+//   read      fread into a free block, cut at the last newline
+//   tokenize  split rows, parse module_id and mark, copy the name
+//   resolve   look up module and component and apply the mark
+// The resolver hands each block back to the reader, so at most
+// PIPELINE_BLOCKS blocks are in flight and a slow stage holds the
+// others back.
+#define PIPELINE_BLOCKS     8
+#define PIPELINE_BLOCK_SIZE (256 * 1024)
+
+typedef enum {
+    PIPELINE_READ,
+    PIPELINE_TOKENIZE,
+    PIPELINE_RESOLVE,
+    PIPELINE_STAGES
+} PipelineStage;
+
+typedef struct {
+    size_t items;                 // bytes read, rows tokenized, rows resolved
+    unsigned long long busy_ns;
+    unsigned long long wait_in_ns;   // waiting for the previous stage
+    unsigned long long wait_out_ns;  // reader only: waiting for a free block (backpressure)
+} PipelineStageStats;
+
+typedef struct {
+    PipelineStageStats stage[PIPELINE_STAGES];
+} PipelineStats;
+
+// Applies the module_id,component_name,mark rows left in in (the header
+// already read) like load_marks does; the caller's thread resolves.
+// stats may be NULL. Returns 0 on a read error or out of memory.
+int pipeline_load_marks(ModuleList *modules, FILE *in, int clear_on_empty, PipelineStats *stats);
+
+// One line per stage, marking the one with the most busy time.
+void pipeline_stats_print(const PipelineStats *stats, FILE *out);
+
+#endif
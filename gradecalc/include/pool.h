@@ -0,0 +1,19 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Called with a half-open range of item indices and the worker running it.
+typedef void (*PoolRangeFn)(void *ctx, size_t begin, size_t end, unsigned worker);
+
+// Runs fn over [0, n) split into chunks of `grain` items on nthreads
+// workers (the caller is worker 0). Each worker starts with a contiguous
+// share of the chunks in its own deque, pops from the front and steals
+// from the back of other deques once it runs dry.
+// Returns 1 on success, 0 if threads could not be started.
+int pool_parallel_for(unsigned nthreads, size_t n, size_t grain, PoolRangeFn fn, void *ctx);
+
+// Number of online CPUs, at least 1.
+unsigned pool_default_threads(void);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "grades.h"
+#include "config.h"
+
+typedef enum {
+    REPORT_CSV,
+    REPORT_JSONL
+} ReportFormat;
+
+// Parses "csv" or "jsonl"; returns 0 for anything else.
+int report_parse_format(const char *name, ReportFormat *fmt);
+
+// Buffered writer for machine-readable output: bytes collect in one
+// 64 KiB buffer and reach the FILE in large fwrite calls.
+#define OUTBUF_SIZE (64 * 1024)
+
+typedef struct {
+    FILE *out;
+    size_t len;
+    int error;
+    char buf[OUTBUF_SIZE];
+} OutBuf;
+
+void outbuf_init(OutBuf *ob, FILE *out);
+void outbuf_put(OutBuf *ob, const char *s, size_t n);
+void outbuf_str(OutBuf *ob, const char *s);
+void outbuf_char(OutBuf *ob, char c);
+void outbuf_num(OutBuf *ob, double v);             // %.2f
+void outbuf_int(OutBuf *ob, long v);
+void outbuf_csv_field(OutBuf *ob, const char *s);   // quoted if needed
+void outbuf_json_string(OutBuf *ob, const char *s);
+// Returns 1 if every byte so far was written.
+int  outbuf_flush(OutBuf *ob);
+
+// The show_report figures for every module plus an OVERALL record,
+// one CSV line or JSON object per record, without any prompts.
+// Returns 1 on success, 0 on allocation or write failure.
+int report_batch(ModuleList *modules, const Config *cfg, ReportFormat fmt, FILE *out);
+
+// The component dictionary: component_id,module_id,component_name per
+// component, for writing cohort files in the component_id format. The
+// dictionary tag such a file's header must carry is in the CSV header
+// (component_id:<tag>) or a first {"dictionary":...} JSON line.
+int report_component_ids(const ModuleList *modules, ReportFormat fmt, FILE *out);
+
+#endif
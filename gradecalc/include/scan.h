@@ -0,0 +1,32 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+// Returned by the scanners when a line holds a '"' or NUL byte and has to
+// go through the scalar CSV tokenizer instead.
+#define SCAN_SLOW ((size_t)-1)
+
+// One field of a line: [begin, end) with surrounding whitespace (isspace,
+// so CR and LF too) already trimmed. An all-blank field is empty at the
+// position of the comma or line end that closes it.
+typedef struct {
+    size_t begin, end;
+} ScanSpan;
+
+// Splits line[0..len) at every ',' and trims each field, in one pass of
+// 16- or 32-byte blocks: comma, quote/NUL and whitespace masks per block,
+// field edges found with bit scans. Writes at most cap spans and returns
+// the number of fields (commas + 1), which may exceed cap; after SCAN_SLOW
+// the spans hold nothing useful.
+// scan_fields picks SSE2 or AVX2 at runtime (once, thread-safe);
+// GRADECALC_SCAN=scalar (or sse2) in the environment forces that kernel.
+size_t scan_fields(const char *line, size_t len, ScanSpan *spans, size_t cap);
+size_t scan_fields_scalar(const char *line, size_t len, ScanSpan *spans, size_t cap);
+
+// A kernel by name ("scalar", "sse2", "avx2"), for differential testing;
+// NULL if it is not built in or this CPU lacks it.
+typedef size_t (*ScanFieldsFn)(const char *, size_t, ScanSpan *, size_t);
+ScanFieldsFn scan_fields_kernel(const char *name);
+
+#endif
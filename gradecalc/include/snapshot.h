@@ -0,0 +1,44 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "grades.h"
+
+// The CSVs a snapshot is derived from. The marks journal (<marks>.journal)
+// is tracked as a fourth source.
+typedef struct {
+    const char *modules;
+    const char *components;
+    const char *marks;
+} SnapshotSources;
+
+#define SNAPSHOT_SOURCES 4
+
+// Identity of a source file at load time; size -1 = file missing.
+typedef struct {
+    long long size;
+    long long mtime_sec;
+    long long mtime_nsec;
+    long long ino;
+} SnapshotStamp;
+
+// Records one file's / the sources' current state.
+void snapshot_stamp_file(const char *path, SnapshotStamp *out);
+// 1 if the two paths are spelled the same or name the same existing file.
+int snapshot_same_file(const char *a, const char *b);
+
+void snapshot_stamp_sources(const SnapshotSources *src, SnapshotStamp stamps[SNAPSHOT_SOURCES]);
+
+// Fills stamps with the sources' current state, then maps snap_path and,
+// if its version, checksum and recorded stamps all match, initializes
+// modules (an arena sized from the snapshot header) and fills it. Returns
+// 1 if loaded; 0 if the CSVs must be parsed instead, with modules not
+// initialized.
+int snapshot_load(ModuleList *modules, const char *snap_path,
+                  const SnapshotSources *src, SnapshotStamp stamps[SNAPSHOT_SOURCES]);
+
+// Writes modules to snap_path (via a temp file and rename), recording the
+// stamps taken before the CSVs were parsed.
+int snapshot_save(const ModuleList *modules, const char *snap_path,
+                  const SnapshotStamp stamps[SNAPSHOT_SOURCES]);
+
+#endif
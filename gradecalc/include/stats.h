@@ -0,0 +1,75 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+// Optional hot-path counters and phase timers, compiled in with
+// -DGRADECALC_STATS (make STATS=1). Without it every macro below expands
+// to nothing and its arguments are not evaluated.
+
+typedef enum {
+    STAT_ROWS_PARSED,
+    STAT_FIELDS_ALLOCATED,   // owning csv_read_row fields
+    STAT_HASH_LOOKUPS,
+    STAT_HASH_PROBES,        // slots visited by those lookups
+    STAT_LINEAR_LOOKUPS,     // header column searches
+    STAT_TOP_K_CALLS,        // best-of selections (top_k_desc replaced qsort)
+    STAT_BYTES_READ,
+    STAT_BYTES_WRITTEN,
+    STAT_COUNTERS
+} StatCounter;
+
+typedef enum {
+    STAT_PHASE_LOAD_MODULES,
+    STAT_PHASE_LOAD_COMPONENTS,
+    STAT_PHASE_LOAD_MARKS,
+    STAT_PHASE_EVALUATE,
+    STAT_PHASE_SAVE,
+    STAT_PHASES
+} StatPhase;
+
+#ifdef GRADECALC_STATS
+
+// One block per thread, registered on first use. When a thread exits its
+// counts are folded into a shared total and the block is freed, so pool
+// workers started per call do not pile up blocks.
+typedef struct StatBlock {
+    unsigned long long counter[STAT_COUNTERS];
+    unsigned long long phase_ns[STAT_PHASES];
+    unsigned long long phase_calls[STAT_PHASES];
+    struct StatBlock *next;
+} StatBlock;
+
+extern _Thread_local StatBlock *stats_local;
+StatBlock *stats_register(void);
+
+static inline StatBlock *stats_block(void) {
+    return stats_local ? stats_local : stats_register();
+}
+
+unsigned long long stats_now_ns(void);
+void stats_phase_add(StatPhase phase, unsigned long long ns);
+
+// Sums every thread's block; call while no worker threads are running.
+void stats_dump(FILE *out);
+void stats_dump_at_exit(void);
+
+#define STATS_ADD(c, n)            (stats_block()->counter[(c)] += (unsigned long long)(n))
+#define STATS_INC(c)               STATS_ADD(c, 1)
+#define STATS_PHASE_BEGIN(t)       unsigned long long t = stats_now_ns()
+#define STATS_PHASE_END(phase, t)  stats_phase_add((phase), stats_now_ns() - (t))
+#define STATS_DUMP(out)            stats_dump(out)
+#define STATS_DUMP_AT_EXIT()       stats_dump_at_exit()
+
+#else
+
+#define STATS_ADD(c, n)            ((void)0)
+#define STATS_INC(c)               ((void)0)
+#define STATS_PHASE_BEGIN(t)       ((void)0)
+#define STATS_PHASE_END(phase, t)  ((void)0)
+#define STATS_DUMP(out)            ((void)0)
+#define STATS_DUMP_AT_EXIT()       ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "grades.h"
+#include "config.h"
+#include "calc.h"
+#include "cohort.h"
+#include "report.h"
+
+// One axis of the what-if grid: from, from + step, ... (count values).
+typedef struct {
+    double from;
+    double step;
+    size_t count;
+} SweepAxis;
+
+// Parses "from:to:step" (or a single value); returns 0 if malformed.
+int  sweep_parse_axis(const char *spec, SweepAxis *ax);
+void sweep_axis_fixed(SweepAxis *ax, double value);
+
+// Every figure show_report derives from target T and assume_other A is
+// linear in them: needed = a + b * T + c * A. A term holds those
+// coefficients for one module's needed average (component NULL), one
+// remaining component's required mark, or the overall figure
+// (module NULL), so the grid is evaluated without touching the marks.
+typedef struct {
+    const Module *module;
+    const Component *component;
+    double a, b, c;
+} SweepTerm;
+
+typedef struct {
+    SweepTerm *items;
+    size_t count;
+    size_t capacity;
+} SweepTerms;
+
+void sweep_terms_init(SweepTerms *t);
+void sweep_terms_free(SweepTerms *t);
+
+// Adds the terms for module m from its sums; marks as in
+// module_sums_bestof_marks (NULL = the components' own).
+int  sweep_add_module(SweepTerms *t, const Module *m, const double *marks, const ModuleSums *ms);
+int  sweep_add_overall(SweepTerms *t, const OverallSums *o);
+
+// Writes one record per grid point and term; sid (may be NULL) becomes a
+// leading student_id column.
+void sweep_write_header(OutBuf *ob, ReportFormat fmt, int with_student);
+void sweep_write(OutBuf *ob, ReportFormat fmt, const char *sid, const SweepTerms *t,
+                 const SweepAxis *target, const SweepAxis *assume);
+
+// The sweep for the loaded marks, or for every student of a cohort.
+int sweep_report(ModuleList *modules, const SweepAxis *target, const SweepAxis *assume,
+                 ReportFormat fmt, FILE *out);
+int sweep_cohort_report(const Cohort *c, const ModuleSums *sums, const SweepAxis *target,
+                        const SweepAxis *assume, ReportFormat fmt, FILE *out);
+
+#endif
@@ -4,6 +4,10 @@
 #include "grades.h"
 #include "config.h"
 
-void ui_run(ModuleList *modules, Config *cfg);
+// Interactive menu. data/*.csv rewritten by another program are merged in
+// as they appear (modules may be replaced wholesale). Returns 0 if a
+// changed modules.csv or components.csv could not be loaded, so what is
+// in memory no longer matches them.
+int ui_run(ModuleList *modules, Config *cfg);
 
 #endif
@@ -0,0 +1,76 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "grades.h"
+#include "cache.h"
+#include "snapshot.h"
+
+// Which data files were rewritten since the last data_watch_poll
+enum {
+    WATCH_MODULES    = 1u << 0,
+    WATCH_COMPONENTS = 1u << 1,
+    WATCH_MARKS      = 1u << 2
+};
+
+// Notices data/*.csv being rewritten in place or renamed over by another
+// program (inotify on Linux; elsewhere nothing is ever reported).
+typedef struct {
+    int fd;   // -1 when not watching
+    int wd;
+} DataWatch;
+
+// Returns 0 (and leaves w inert) if dir cannot be watched.
+int  data_watch_open(DataWatch *w, const char *dir);
+void data_watch_close(DataWatch *w);
+
+// Drains pending events without blocking; WATCH_* bits of the files touched.
+unsigned data_watch_poll(DataWatch *w);
+
+// marks.csv as last read or written by us, per component dictionary id
+// (-1 = unset). A component whose in-memory mark differs from its base
+// has been edited locally since.
+typedef struct {
+    double *base;
+    size_t count;
+    SnapshotStamp saved;   // marks.csv as our last save left it
+} MarksBase;
+
+// Takes the base from path, ignoring its journal: journaled edits count
+// as local ones.
+int  marks_base_init(MarksBase *b, ModuleList *modules, const char *path);
+void marks_base_free(MarksBase *b);
+
+// After the in-memory marks were saved to path: the base becomes the marks
+// as written (rounded to two places), and the event for that very file
+// is not taken for a change on disk.
+void marks_base_saved(MarksBase *b, ModuleList *modules, const char *path);
+
+typedef struct {
+    size_t applied;
+    size_t conflicts;
+} MarksReload;
+
+// Re-reads path and applies every component whose mark on disk moved from
+// its base: the new mark is set and marked dirty in rc. A component also
+// edited locally to something else keeps the local mark and is listed on
+// log as a conflict. The base then follows the file.
+int marks_reload(ModuleList *modules, ReportCache *rc, MarksBase *b, const char *path,
+                 FILE *log, MarksReload *out);
+
+typedef struct {
+    size_t modules_added, modules_removed, modules_changed;
+    size_t components_added, components_removed, components_changed;
+} SchemaReload;
+
+// Reads both schema files again and, if they describe anything different,
+// swaps the new list in for *modules. Marks (current and base) carry over
+// by module id and component name; new components start unset. Component
+// ids and any ReportCache over modules are then stale. Returns 0, leaving
+// modules as they were, if the files cannot be read.
+int schema_reload(ModuleList *modules, MarksBase *b, const char *modules_path,
+                  const char *components_path, SchemaReload *out);
+
+#endif
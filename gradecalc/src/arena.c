@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_BLOCK (64 * 1024)
+
+struct ArenaBlock {
+    ArenaBlock *prev;
+    size_t size;
+    size_t used;
+    size_t last;   // offset of the most recent allocation
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+void arena_init(Arena *a, size_t first_block) {
+    a->head = NULL;
+    a->next_size = (first_block < ARENA_MIN_BLOCK) ? ARENA_MIN_BLOCK : align_up(first_block);
+    a->blocks = 0;
+    a->bytes = 0;
+}
+
+static int arena_new_block(Arena *a, size_t need) {
+    size_t size = a->next_size;
+    while (size < need) size *= 2;
+
+    ArenaBlock *b = malloc(sizeof(ArenaBlock) + size);
+    if (!b) return 0;
+    b->prev = a->head;
+    b->size = size;
+    b->used = 0;
+    b->last = 0;
+
+    a->head = b;
+    a->next_size = size * 2;
+    a->blocks++;
+    return 1;
+}
+
+void *arena_alloc(Arena *a, size_t size) {
+    size = align_up(size ? size : 1);
+    ArenaBlock *b = a->head;
+    if (!b || b->size - b->used < size) {
+        if (!arena_new_block(a, size)) return NULL;
+        b = a->head;
+    }
+
+    b->last = b->used;
+    b->used += size;
+    a->bytes += size;
+    return b->data + b->last;
+}
+
+void *arena_realloc(Arena *a, void *p, size_t old_size, size_t new_size) {
+    if (!p) return arena_alloc(a, new_size);
+
+    ArenaBlock *b = a->head;
+    if (b && (unsigned char *)p == b->data + b->last) {
+        size_t want = align_up(new_size ? new_size : 1);
+        if (b->last + want <= b->size) {
+            a->bytes = a->bytes - (b->used - b->last) + want;
+            b->used = b->last + want;
+            return p;
+        }
+    }
+
+    void *np = arena_alloc(a, new_size);
+    if (!np) return NULL;
+    memcpy(np, p, old_size < new_size ? old_size : new_size);
+    return np;
+}
+
+void arena_free(Arena *a) {
+    ArenaBlock *b = a->head;
+    while (b) {
+        ArenaBlock *prev = b->prev;
+        free(b);
+        b = prev;
+    }
+    a->head = NULL;
+    a->blocks = 0;
+    a->bytes = 0;
+}
@@ -0,0 +1,115 @@
+#include <stdlib.h>
+
+#include "cache.h"
+#include "stats.h"
+
+static void module_cache_total(const Module *m, ModuleCache *mc) {
+    // same order as module_sums_bestof: plain, then groups
+    mc->total = mc->plain;
+    for (size_t g = 0; g < m->group_count; g++) {
+        mc->total.S += mc->group[g].S;
+        mc->total.W += mc->group[g].W;
+        mc->total.R += mc->group[g].R;
+    }
+}
+
+int report_cache_init(ReportCache *rc, ModuleList *modules) {
+    rc->modules = modules;
+    rc->mods = calloc(modules->count ? modules->count : 1, sizeof(ModuleCache));
+    rc->scratch = NULL;
+    overall_init(&rc->overall);
+    if (!rc->mods) return 0;
+
+    size_t max_group = 1;
+    for (size_t i = 0; i < modules->count; i++) {
+        Module *m = &modules->items[i];
+        if (!m->component_group && !module_build_groups(m)) goto fail;
+        if (m->max_group_size > max_group) max_group = m->max_group_size;
+
+        ModuleCache *mc = &rc->mods[i];
+        size_t ng = m->group_count ? m->group_count : 1;
+        mc->group = malloc(ng * sizeof(ModuleSums));
+        mc->group_dirty = calloc(ng, 1);
+        if (!mc->group || !mc->group_dirty) goto fail;
+    }
+
+    rc->scratch = malloc(max_group * sizeof(double));
+    if (!rc->scratch) goto fail;
+
+    STATS_PHASE_BEGIN(t0);
+    for (size_t i = 0; i < modules->count; i++) {
+        const Module *m = &modules->items[i];
+        ModuleCache *mc = &rc->mods[i];
+
+        module_sums_plain(m, NULL, &mc->plain);
+        for (size_t g = 0; g < m->group_count; g++)
+            module_sums_group(m, g, NULL, rc->scratch, &mc->group[g]);
+        module_cache_total(m, mc);
+
+        overall_add(&rc->overall, m->credits, mc->total.S, mc->total.W, mc->total.R);
+    }
+    STATS_PHASE_END(STAT_PHASE_EVALUATE, t0);
+    return 1;
+
+fail:
+    report_cache_free(rc);
+    return 0;
+}
+
+void report_cache_free(ReportCache *rc) {
+    if (!rc || !rc->mods) return;
+    for (size_t i = 0; i < rc->modules->count; i++) {
+        free(rc->mods[i].group);
+        free(rc->mods[i].group_dirty);
+    }
+    free(rc->mods);
+    free(rc->scratch);
+    rc->mods = NULL;
+    rc->scratch = NULL;
+}
+
+void report_cache_mark_dirty(ReportCache *rc, const Module *m, size_t component) {
+    ModuleCache *mc = &rc->mods[m - rc->modules->items];
+    int g = m->component_group[component];
+    if (g < 0) mc->plain_dirty = 1;
+    else mc->group_dirty[g] = 1;
+    mc->dirty = 1;
+}
+
+void report_cache_refresh(ReportCache *rc) {
+    STATS_PHASE_BEGIN(t0);
+    int changed = 0;
+    for (size_t i = 0; i < rc->modules->count; i++) {
+        ModuleCache *mc = &rc->mods[i];
+        if (!mc->dirty) continue;
+
+        const Module *m = &rc->modules->items[i];
+        if (mc->plain_dirty) module_sums_plain(m, NULL, &mc->plain);
+        for (size_t g = 0; g < m->group_count; g++) {
+            if (!mc->group_dirty[g]) continue;
+            module_sums_group(m, g, NULL, rc->scratch, &mc->group[g]);
+            mc->group_dirty[g] = 0;
+        }
+        mc->plain_dirty = 0;
+        mc->dirty = 0;
+        module_cache_total(m, mc);
+        changed = 1;
+    }
+
+    // The overall is summed again from the cached module totals, in the
+    // same order as report_cache_init: O(modules), no module re-evaluated,
+    // and no new-minus-old drift (B must come back to exactly 0 once
+    // everything is marked)
+    if (changed) {
+        overall_init(&rc->overall);
+        for (size_t i = 0; i < rc->modules->count; i++) {
+            const ModuleSums *t = &rc->mods[i].total;
+            overall_add(&rc->overall, rc->modules->items[i].credits, t->S, t->W, t->R);
+        }
+    }
+    STATS_PHASE_END(STAT_PHASE_EVALUATE, t0);
+}
+
+const ModuleSums *report_cache_module(const ReportCache *rc, size_t module_index) {
+    return &rc->mods[module_index].total;
+}
@@ -1,66 +1,129 @@
+#include <math.h>
 #include <stdlib.h>
 
 #include "grades.h"
 #include "calc.h"
+#include "stats.h"
 
-/* -------------------- Best-of-N core (optional) -------------------- */
+/* -------------------- Top-k selection -------------------- */
 
-static int cmp_desc_double(const void *a, const void *b) {
-    double da = *(const double*)a;
-    double db = *(const double*)b;
-    if (da < db) return 1;
-    if (da > db) return -1;
-    return 0;
+static void swap_d(double *a, double *b) {
+    double t = *a; *a = *b; *b = t;
 }
 
-void module_sums_bestof(const Module *m, double *outS, double *outW, double *outR) {
-    double S = 0.0, W = 0.0, R = 0.0;
+static void insertion_sort_desc(double *a, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        double x = a[i];
+        size_t j = i;
+        while (j > 0 && a[j - 1] < x) { a[j] = a[j - 1]; j--; }
+        a[j] = x;
+    }
+}
 
-    for (size_t i = 0; i < m->component_count; i++) {
-        const Component *c = &m->components[i];
+// Partitions a[0..n) (n >= 3) around a median-of-three pivot so that
+// a[0..p] >= pivot >= a[p+1..n); returns p.
+static size_t partition_desc(double *a, size_t n) {
+    size_t mid = n / 2;
+    if (a[mid] > a[0]) swap_d(&a[mid], &a[0]);
+    if (a[n - 1] > a[0]) swap_d(&a[n - 1], &a[0]);
+    if (a[n - 1] > a[mid]) swap_d(&a[n - 1], &a[mid]);
+    double pivot = a[mid];
 
-        // Normal component
-        if (c->group_id == 0 || c->best_of == 0) {
-            if (c->mark >= 0.0) { S += c->mark * c->weight; W += c->weight; }
-            else { R += c->weight; }
-            continue;
-        }
+    size_t i = 0, j = n - 1;
+    while (1) {
+        while (a[i] > pivot) i++;
+        while (a[j] < pivot) j--;
+        if (i >= j) return j;
+        swap_d(&a[i], &a[j]);
+        i++;
+        j--;
+    }
+}
 
-        // Grouped: process each group once
-        int gid = c->group_id;
-        int best_of = c->best_of;
+static void sort_desc(double *a, size_t n) {
+    while (n > 16) {
+        size_t p = partition_desc(a, n) + 1;
+        // recurse into the smaller side, loop on the larger
+        if (p < n - p) { sort_desc(a, p); a += p; n -= p; }
+        else { sort_desc(a + p, n - p); n = p; }
+    }
+    insertion_sort_desc(a, n);
+}
+
+void top_k_desc(double *a, size_t n, size_t k) {
+    STATS_INC(STAT_TOP_K_CALLS);
+    if (k == 0 || n == 0) return;
+    if (k > n) k = n;
 
-        int already_done = 0;
-        for (size_t k = 0; k < i; k++) {
-            if (m->components[k].group_id == gid && m->components[k].best_of == best_of) {
-                already_done = 1;
-                break;
-            }
+    if (k <= 8) {
+        // Small k: a[0..k) is a sorted window of the best seen so far; a
+        // larger mark trades places with the window's smallest
+        insertion_sort_desc(a, k);
+        for (size_t i = k; i < n; i++) {
+            double x = a[i];
+            if (!(x > a[k - 1])) continue;
+            a[i] = a[k - 1];
+            size_t j = k - 1;
+            while (j > 0 && a[j - 1] < x) { a[j] = a[j - 1]; j--; }
+            a[j] = x;
         }
-        if (already_done) continue;
+        return;
+    }
 
-        double marks[256];
-        int nmarks = 0;
-        double item_weight = -1.0;
+    // nth_element-style selection of the k largest, then order just those
+    double *lo = a;
+    size_t len = n, want = k;
+    while (len > 16 && want < len) {
+        size_t p = partition_desc(lo, len) + 1;
+        if (want <= p) { len = p; }
+        else { lo += p; len -= p; want -= p; }
+    }
+    if (want < len) insertion_sort_desc(lo, len);
+    sort_desc(a, k);
+}
+
+/* -------------------- Best-of-N core (optional) -------------------- */
 
-        for (size_t j = 0; j < m->component_count; j++) {
-            const Component *cj = &m->components[j];
-            if (cj->group_id != gid || cj->best_of != best_of) continue;
+// Mark of component i, taken from the external row when one is given
+static double mark_at(const Module *m, const double *marks, size_t i) {
+    return marks ? marks[i] : m->components[i].mark;
+}
 
-            if (item_weight < 0.0) item_weight = cj->weight;
+void module_sums_plain(const Module *m, const double *marks, ModuleSums *out) {
+    double S = 0.0, W = 0.0, R = 0.0;
 
-            if (cj->mark >= 0.0 && nmarks < (int)(sizeof marks / sizeof marks[0])) {
-                marks[nmarks++] = cj->mark;
-            }
-        }
+    for (size_t i = 0; i < m->component_count; i++) {
+        if (m->component_group[i] >= 0) continue;
+
+        const Component *c = &m->components[i];
+        double mark = mark_at(m, marks, i);
+        if (mark >= 0.0) { S += mark * c->weight; W += c->weight; }
+        else { R += c->weight; }
+    }
+
+    *out = (ModuleSums){ S, W, R };
+}
 
-        if (item_weight < 0.0) continue;
+void module_sums_group(const Module *m, size_t g, const double *marks,
+                       double *scratch, ModuleSums *out) {
+    double S = 0.0, W = 0.0, R = 0.0;
+    const ComponentGroup *grp = &m->groups[g];
 
-        qsort(marks, (size_t)nmarks, sizeof(double), cmp_desc_double);
+    if (grp->item_weight >= 0.0) {
+        const size_t *members = m->group_members + grp->member_start;
+        int nmarks = 0;
+        for (size_t k = 0; k < grp->member_count; k++) {
+            double mk = mark_at(m, marks, members[k]);
+            if (mk >= 0.0) scratch[nmarks++] = mk;
+        }
 
+        int best_of = grp->best_of;
+        if (best_of > 0) top_k_desc(scratch, (size_t)nmarks, (size_t)best_of);
+
+        double item_weight = grp->item_weight;
         int counted = (nmarks < best_of) ? nmarks : best_of;
         for (int t = 0; t < counted; t++) {
-            S += marks[t] * item_weight;
+            S += scratch[t] * item_weight;
             W += item_weight;
         }
 
@@ -69,7 +132,161 @@ void module_sums_bestof(const Module *m, double *outS, double *outW, double *out
         }
     }
 
-    *outS = S;
-    *outW = W;
-    *outR = R;
+    *out = (ModuleSums){ S, W, R };
+}
+
+/*
+With t unmarked members scoring x, the group's best-of total is
+max over t of (t * x + P(k - t)), where P(j) is the sum of the best j
+existing marks. Reaching v therefore needs x >= min over t >= 1 of
+(v - P(k - t)) / t, which one partial sort and a prefix sum give for
+every t at once.
+*/
+int module_group_required(const Module *m, size_t g, const double *marks,
+                          const ModuleSums *total, double target, double assume_other,
+                          double *scratch, GroupRequired *out) {
+    const ComponentGroup *grp = &m->groups[g];
+    const size_t *members = m->group_members + grp->member_start;
+    const double w = grp->item_weight;
+    const size_t k = grp->best_of > 0 ? (size_t)grp->best_of : 0;
+
+    size_t n = 0;
+    for (size_t i = 0; i < grp->member_count; i++) {
+        double mk = mark_at(m, marks, members[i]);
+        if (mk >= 0.0) scratch[n++] = mk;
+    }
+    const size_t u = grp->member_count - n;
+
+    out->remaining = u;
+    out->uniform = out->single = -INFINITY;
+    if (u == 0 || w <= 0.0 || k == 0) return 0;
+
+    // Marks (v) the best-of items must add up to, with the rest of the
+    // module as in print_module_stats: marked work, others at assume_other
+    ModuleSums own;
+    module_sums_group(m, g, marks, scratch, &own);
+    double points = target * 100.0 - (total->S - own.S) - assume_other * (total->R - own.R);
+    double v = points / w;
+
+    // Uniform mark on every unmarked member
+    n = 0;
+    for (size_t i = 0; i < grp->member_count; i++) {
+        double mk = mark_at(m, marks, members[i]);
+        if (mk >= 0.0) scratch[n++] = mk;
+    }
+    size_t top = k < n ? k : n;
+    top_k_desc(scratch, n, top);
+
+    double prefix = 0.0;
+    for (size_t i = 0; i < top; i++) prefix += scratch[i];
+
+    if (prefix < v) {
+        // P(j) for j = top down to k - min(u, k), peeling off the smallest
+        size_t tmax = u < k ? u : k;
+        double best = INFINITY;
+        size_t j = top;
+        for (size_t t = 1; t <= tmax; t++) {
+            size_t want = k - t;
+            while (j > want) prefix -= scratch[--j];
+            double x = (v - prefix) / (double)t;
+            if (x < best) best = x;
+        }
+        out->uniform = best;
+    }
+
+    // One unmarked member, the others at assume_other
+    n = 0;
+    for (size_t i = 0; i < grp->member_count; i++) {
+        double mk = mark_at(m, marks, members[i]);
+        if (mk >= 0.0) scratch[n++] = mk;
+    }
+    for (size_t i = 1; i < u; i++) scratch[n++] = assume_other;
+
+    top = k < n ? k : n;
+    top_k_desc(scratch, n, top);
+
+    double best_k = 0.0;
+    for (size_t i = 0; i < top; i++) best_k += scratch[i];
+    if (best_k < v) {
+        double best_k1 = (n >= k) ? best_k - scratch[k - 1] : best_k;
+        out->single = v - best_k1;
+    }
+    return 1;
+}
+
+// Plain components first, then each group in table order. The report
+// cache adds its cached parts in the same order, so both agree exactly.
+static int sums_with_groups(const Module *m, const double *marks,
+                            double *outS, double *outW, double *outR) {
+    double stack_buf[256];
+    double *scratch = stack_buf;
+    if (m->max_group_size > sizeof stack_buf / sizeof stack_buf[0]) {
+        scratch = malloc(m->max_group_size * sizeof(double));
+        if (!scratch) {
+            *outS = *outW = *outR = 0.0;
+            return 0;
+        }
+    }
+
+    ModuleSums total, part;
+    module_sums_plain(m, marks, &total);
+
+    for (size_t g = 0; g < m->group_count; g++) {
+        module_sums_group(m, g, marks, scratch, &part);
+        total.S += part.S;
+        total.W += part.W;
+        total.R += part.R;
+    }
+
+    if (scratch != stack_buf) free(scratch);
+
+    *outS = total.S;
+    *outW = total.W;
+    *outR = total.R;
+    return 1;
+}
+
+int module_sums_bestof_marks(const Module *m, const double *marks,
+                             double *outS, double *outW, double *outR) {
+    if (m->component_group || m->component_count == 0) {
+        return sums_with_groups(m, marks, outS, outW, outR);
+    }
+
+    // Group table not built yet (components added since): build a private one
+    Module tmp = *m;
+    tmp.component_group = NULL;
+    tmp.groups = NULL;
+    tmp.group_members = NULL;
+    tmp.arena = NULL;  // scratch table: keep it out of the list's arena
+    if (!module_build_groups(&tmp)) {
+        *outS = *outW = *outR = 0.0;
+        return 0;
+    }
+    int ok = sums_with_groups(&tmp, marks, outS, outW, outR);
+    module_free_groups(&tmp);
+    return ok;
+}
+
+int module_sums_bestof(const Module *m, double *outS, double *outW, double *outR) {
+    return module_sums_bestof_marks(m, NULL, outS, outW, outR);
+}
+
+/* -------------------- Credit-weighted overall -------------------- */
+
+void overall_init(OverallSums *o) {
+    o->total_credits = 0.0;
+    o->A = 0.0;
+    o->B = 0.0;
+    o->credit_S = 0.0;
+    o->credit_W = 0.0;
+}
+
+void overall_add(OverallSums *o, int credits, double S, double W, double R) {
+    o->total_credits += credits;
+
+    o->A += credits * (S / 100.0);
+    o->B += credits * (R / 100.0);
+
+    o->credit_S += credits * S;
+    o->credit_W += credits * W;
 }
@@ -0,0 +1,350 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cohort.h"
+#include "calc.h"
+#include "columns.h"
+#include "pool.h"
+#include "report.h"
+#include "stats.h"
+
+/* -------------------- Student index -------------------- */
+
+static size_t hash_str(const char *s) {
+    unsigned long long h = 1469598103934665603ULL; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+static void id_insert(Cohort *c, size_t idx) {
+    size_t mask = c->id_cap - 1;
+    size_t s = hash_str(c->student_ids[idx]) & mask;
+    while (c->id_slots[s] != 0) s = (s + 1) & mask;
+    c->id_slots[s] = idx + 1;
+}
+
+static int id_rebuild(Cohort *c, size_t want) {
+    size_t cap = 16;
+    while (cap < want * 2) cap *= 2;
+    size_t *slots = calloc(cap, sizeof(size_t));
+    if (!slots) return 0;
+    free(c->id_slots);
+    c->id_slots = slots;
+    c->id_cap = cap;
+    for (size_t i = 0; i < c->student_count; i++) id_insert(c, i);
+    return 1;
+}
+
+static long id_find(const Cohort *c, const char *student_id) {
+    STATS_INC(STAT_HASH_LOOKUPS);
+    if (c->id_cap == 0) return -1;
+    size_t mask = c->id_cap - 1;
+    for (size_t s = hash_str(student_id) & mask; c->id_slots[s] != 0; s = (s + 1) & mask) {
+        STATS_INC(STAT_HASH_PROBES);
+        size_t idx = c->id_slots[s] - 1;
+        if (strcmp(c->student_ids[idx], student_id) == 0) return (long)idx;
+    }
+    return -1;
+}
+
+/* -------------------- Cohort -------------------- */
+
+int cohort_init(Cohort *c, ModuleList *schema) {
+    memset(c, 0, sizeof *c);
+    c->schema = schema;
+
+    c->module_offset = malloc((schema->count + 1) * sizeof(size_t));
+    if (!c->module_offset) return 0;
+
+    size_t col = 0;
+    for (size_t i = 0; i < schema->count; i++) {
+        c->module_offset[i] = col;
+        col += schema->items[i].component_count;
+    }
+    c->module_offset[schema->count] = col;
+    c->column_count = col;
+    return 1;
+}
+
+void cohort_free(Cohort *c) {
+    if (!c) return;
+    for (size_t i = 0; i < c->student_count; i++) free(c->student_ids[i]);
+    free(c->student_ids);
+    free(c->marks);
+    free(c->module_offset);
+    free(c->id_slots);
+    memset(c, 0, sizeof *c);
+}
+
+static int cohort_grow(Cohort *c) {
+    size_t newcap = (c->student_capacity == 0) ? 64 : c->student_capacity * 2;
+
+    char **ids = realloc(c->student_ids, newcap * sizeof(char *));
+    if (!ids) return 0;
+    c->student_ids = ids;
+
+    // keep the request non-zero for a schema without components
+    size_t bytes = newcap * c->column_count * sizeof(double);
+    double *marks = realloc(c->marks, bytes ? bytes : sizeof(double));
+    if (!marks) return 0;
+    c->marks = marks;
+
+    c->student_capacity = newcap;
+    return 1;
+}
+
+long cohort_student(Cohort *c, const char *student_id) {
+    long found = id_find(c, student_id);
+    if (found >= 0) return found;
+
+    if (c->student_count == c->student_capacity && !cohort_grow(c)) return -1;
+    if ((c->student_count + 1) * 2 > c->id_cap && !id_rebuild(c, c->student_count + 1)) return -1;
+
+    size_t n = strlen(student_id);
+    char *id = malloc(n + 1);
+    if (!id) return -1;
+    memcpy(id, student_id, n + 1);
+
+    size_t idx = c->student_count++;
+    c->student_ids[idx] = id;
+
+    double *row = cohort_row(c, idx);
+    for (size_t j = 0; j < c->column_count; j++) row[j] = -1.0;
+
+    id_insert(c, idx);
+    return (long)idx;
+}
+
+double *cohort_row(const Cohort *c, size_t student) {
+    return c->marks + student * c->column_count;
+}
+
+size_t cohort_column(const Cohort *c, const Module *m, const Component *comp) {
+    size_t mi = (size_t)(m - c->schema->items);
+    return c->module_offset[mi] + (size_t)(comp - m->components);
+}
+
+/* -------------------- Evaluation -------------------- */
+
+void cohort_eval_module(const ModuleList *schema, const ComponentColumns *cols, size_t i,
+                        const double *row, double *scratch, ModuleSums *out) {
+    const Module *m = &schema->items[i];
+    size_t off = cols->module_offset[i];
+
+    // Ungrouped part from the columnar kernel, then each best-of group
+    ModuleSums total, part;
+    columns_plain_sums(cols, row, off, off + m->component_count, &total);
+    for (size_t g = 0; g < m->group_count; g++) {
+        module_sums_group(m, g, row + off, scratch, &part);
+        total.S += part.S;
+        total.W += part.W;
+        total.R += part.R;
+    }
+    *out = total;
+}
+
+int cohort_prepare_schema(ModuleList *schema, size_t *max_group_size) {
+    size_t max_group = 0;
+    for (size_t i = 0; i < schema->count; i++) {
+        Module *m = &schema->items[i];
+        if (!m->component_group && !module_build_groups(m)) return 0;
+        if (m->max_group_size > max_group) max_group = m->max_group_size;
+    }
+    *max_group_size = max_group;
+    return 1;
+}
+
+typedef struct {
+    const Cohort *cohort;
+    const ComponentColumns *cols;
+    size_t max_group_size;
+    ModuleSums *sums;
+    int failed;
+} EvalJob;
+
+static void eval_range(void *ctx, size_t begin, size_t end, unsigned worker) {
+    (void)worker;
+    EvalJob *job = (EvalJob *)ctx;
+    const Cohort *c = job->cohort;
+    size_t nmod = c->schema->count;
+
+    double stack_buf[256];
+    double *scratch = stack_buf;
+    if (job->max_group_size > sizeof stack_buf / sizeof stack_buf[0]) {
+        scratch = malloc(job->max_group_size * sizeof(double));
+        if (!scratch) {
+            job->failed = 1;   // sums[begin..end) left unset
+            return;
+        }
+    }
+
+    for (size_t k = begin; k < end; k++) {
+        size_t s = k / nmod, i = k % nmod;
+        cohort_eval_module(c->schema, job->cols, i, cohort_row(c, s), scratch, &job->sums[k]);
+    }
+
+    if (scratch != stack_buf) free(scratch);
+}
+
+ModuleSums *cohort_evaluate(const Cohort *c, unsigned nthreads) {
+    size_t max_group = 0;
+    if (!cohort_prepare_schema(c->schema, &max_group)) return NULL;
+
+    ComponentColumns cols;
+    if (!columns_build(&cols, c->schema)) return NULL;
+
+    size_t n = c->student_count * c->schema->count;
+    ModuleSums *sums = malloc((n ? n : 1) * sizeof(ModuleSums));
+    if (!sums) {
+        columns_free(&cols);
+        return NULL;
+    }
+
+    EvalJob job = { c, &cols, max_group, sums, 0 };
+    STATS_PHASE_BEGIN(t0);
+    int ok = pool_parallel_for(nthreads, n, 1024, eval_range, &job) && !job.failed;
+    STATS_PHASE_END(STAT_PHASE_EVALUATE, t0);
+    columns_free(&cols);
+    if (!ok) {
+        free(sums);
+        return NULL;
+    }
+    return sums;
+}
+
+/* -------------------- Report -------------------- */
+
+static void put_num(OutBuf *ob, double v) {
+    outbuf_char(ob, ',');
+    outbuf_num(ob, v);
+}
+
+void cohort_write_header(OutBuf *ob) {
+    outbuf_str(ob, "student_id,module,current_avg,earned,remaining_weight,needed_avg\n");
+}
+
+void cohort_write_student(OutBuf *ob, const ModuleList *modules, const char *sid,
+                          const ModuleSums *ms, const Config *cfg) {
+    const double TARGET = cfg->target;
+
+    OverallSums o;
+    overall_init(&o);
+
+    for (size_t i = 0; i < modules->count; i++) {
+        const Module *m = &modules->items[i];
+
+        double S = ms[i].S, W = ms[i].W, R = ms[i].R;
+        overall_add(&o, m->credits, S, W, R);
+
+        outbuf_csv_field(ob, sid);
+        outbuf_char(ob, ',');
+        outbuf_csv_field(ob, m->code);
+        if (W > 0.0) put_num(ob, S / W); else outbuf_char(ob, ',');
+        put_num(ob, S / 100.0);
+        put_num(ob, R);
+
+        // Same cases as print_module_stats
+        if (R <= 0.0) outbuf_char(ob, ',');
+        else if (W <= 0.0) put_num(ob, TARGET);
+        else put_num(ob, (TARGET * 100.0 - S) / R);
+        outbuf_char(ob, '\n');
+    }
+
+    outbuf_csv_field(ob, sid);
+    outbuf_str(ob, ",OVERALL");
+    if (o.credit_W > 0.0) put_num(ob, o.credit_S / o.credit_W); else outbuf_char(ob, ',');
+    if (o.total_credits > 0.0) {
+        put_num(ob, o.A / o.total_credits);
+        put_num(ob, o.B / o.total_credits * 100.0);
+    } else {
+        outbuf_str(ob, ",,");
+    }
+    if (o.B <= 0.0) outbuf_char(ob, ',');
+    else put_num(ob, (TARGET * o.total_credits - o.A) / o.B);
+    outbuf_char(ob, '\n');
+}
+
+int cohort_report_csv(const Cohort *c, const ModuleSums *sums, const Config *cfg, FILE *out) {
+    OutBuf *ob = malloc(sizeof *ob);
+    if (!ob) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+    outbuf_init(ob, out);
+
+    cohort_write_header(ob);
+    for (size_t s = 0; s < c->student_count; s++) {
+        cohort_write_student(ob, c->schema, c->student_ids[s],
+                             sums + s * c->schema->count, cfg);
+    }
+
+    int ok = outbuf_flush(ob);
+    if (!ok) fprintf(stderr, "Failed to write report\n");
+    free(ob);
+    return ok;
+}
+
+// Empty when already safe
+static void put_needed(OutBuf *ob, double v) {
+    outbuf_char(ob, ',');
+    if (v > -INFINITY) outbuf_num(ob, v);
+}
+
+int cohort_group_report_csv(const Cohort *c, const ModuleSums *sums, const Config *cfg, FILE *out) {
+    const ModuleList *schema = c->schema;
+
+    size_t max_group = 0;
+    for (size_t i = 0; i < schema->count; i++)
+        if (schema->items[i].max_group_size > max_group) max_group = schema->items[i].max_group_size;
+
+    OutBuf *ob = malloc(sizeof *ob);
+    double *scratch = malloc((max_group ? max_group : 1) * sizeof(double));
+    if (!ob || !scratch) {
+        fprintf(stderr, "Out of memory\n");
+        free(ob);
+        free(scratch);
+        return 0;
+    }
+
+    outbuf_init(ob, out);
+    outbuf_str(ob, "student_id,module,group_id,best_of,remaining,needed_each,needed_one\n");
+
+    for (size_t s = 0; s < c->student_count; s++) {
+        const double *row = cohort_row(c, s);
+        const ModuleSums *ms = sums + s * schema->count;
+
+        for (size_t i = 0; i < schema->count; i++) {
+            const Module *m = &schema->items[i];
+            for (size_t g = 0; g < m->group_count; g++) {
+                GroupRequired req;
+                if (!module_group_required(m, g, row + c->module_offset[i], &ms[i],
+                                           cfg->target, cfg->assume_other, scratch, &req))
+                    continue;
+
+                outbuf_csv_field(ob, c->student_ids[s]);
+                outbuf_char(ob, ',');
+                outbuf_csv_field(ob, m->code);
+                outbuf_char(ob, ',');
+                outbuf_int(ob, m->groups[g].group_id);
+                outbuf_char(ob, ',');
+                outbuf_int(ob, m->groups[g].best_of);
+                outbuf_char(ob, ',');
+                outbuf_int(ob, (long)req.remaining);
+                put_needed(ob, req.uniform);
+                put_needed(ob, req.single);
+                outbuf_char(ob, '\n');
+            }
+        }
+    }
+
+    int ok = outbuf_flush(ob);
+    if (!ok) fprintf(stderr, "Failed to write report\n");
+    free(ob);
+    free(scratch);
+    return ok;
+}
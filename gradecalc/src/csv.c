@@ -1,13 +1,39 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "csv.h"
+#include "scan.h"
+#include "stats.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 struct CsvFile {
     FILE *fp;
+    int owns_fp;   // 0 for stdin
     char *line;
     size_t linecap;
+    char *cur;     // the line just read: line, or in place in copy
+
+    // Whole-file mapping used by csv_open_mmap (NULL on the stdio path)
+    const char *map;
+    size_t map_len;
+    size_t map_pos;
+    int owns_map;  // 0 for slices of another file's mapping
+    char *copy;    // csv_open_copy's buffer, which map points into
+    int writable;  // map is our own buffer: lines are split where they lie
+
+    // Field table reused by csv_read_row_view
+    char **fields;
+    size_t fieldcap;
+
+    // Field spans from scan_fields
+    ScanSpan *spans;
+    size_t spancap;
 };
 
 static char *str_dup_range(const char *start, const char *end) {
@@ -41,13 +67,147 @@ CsvFile *csv_open(const char *path) {
         free(f);
         return NULL;
     }
+    f->owns_fp = 1;
+    return f;
+}
+
+CsvFile *csv_open_mmap(const char *path) {
+    CsvFile *f = (CsvFile *)calloc(1, sizeof(CsvFile));
+    if (!f) return NULL;
+
+    if (strcmp(path, "-") == 0) {
+        f->fp = stdin;
+        return f;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        free(f);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            close(fd);
+#ifdef MADV_SEQUENTIAL
+            (void)madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            f->map = (const char *)map;
+            f->map_len = (size_t)st.st_size;
+            f->owns_map = 1;
+            return f;
+        }
+    }
+
+    // Pipes, FIFOs, empty files or a failed map: read through stdio
+    f->fp = fdopen(fd, "r");
+    if (!f->fp) {
+        close(fd);
+        free(f);
+        return NULL;
+    }
+    f->owns_fp = 1;
+    return f;
+}
+
+size_t csv_count_rows(const char *path) {
+    CsvFile *f = csv_open_mmap(path);
+    if (!f) return 0;
+    size_t rows = csv_count_lines(f);
+    csv_close(f);
+    return rows;
+}
+
+size_t csv_count_lines(const CsvFile *f) {
+    size_t rows = 0;
+    if (f->map) {
+        const char *p = f->map + f->map_pos, *end = f->map + f->map_len;
+        while (p < end) {
+            const char *nl = (const char *)memchr(p, '\n', (size_t)(end - p));
+            rows++;
+            if (!nl) break;
+            p = nl + 1;
+        }
+    }
+    return rows;
+}
+
+size_t csv_mapped_size(const CsvFile *f) {
+    return f->map ? f->map_len : 0;
+}
+
+size_t csv_tell(const CsvFile *f) {
+    return f->map_pos;
+}
+
+size_t csv_line_start(const CsvFile *f, size_t pos) {
+    if (pos >= f->map_len) return f->map_len;
+    // Lines already read may have had their '\n' overwritten
+    if (pos <= f->map_pos) return f->map_pos;
+    if (f->map[pos - 1] == '\n') return pos;
+    const char *nl = (const char *)memchr(f->map + pos, '\n', f->map_len - pos);
+    return nl ? (size_t)(nl - f->map) + 1 : f->map_len;
+}
+
+CsvFile *csv_open_slice(const CsvFile *f, size_t begin, size_t end) {
+    CsvFile *s = csv_open_memory(f->map + begin, end - begin);
+    if (s) s->writable = f->writable;   // slices never share a line
+    return s;
+}
+
+CsvFile *csv_open_copy(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    for (;;) {
+        if (len == cap) {
+            size_t newcap = cap ? cap * 2 : 64 * 1024;
+            char *nb = (char *)realloc(buf, newcap);
+            if (!nb) break;
+            buf = nb;
+            cap = newcap;
+        }
+        size_t n = fread(buf + len, 1, cap - len, fp);
+        len += n;
+        if (n == 0) break;
+    }
+    int ok = !ferror(fp) && len < cap;
+    fclose(fp);
+
+    CsvFile *f = ok ? csv_open_memory(buf, len) : NULL;
+    if (!f) {
+        free(buf);
+        return NULL;
+    }
+    f->copy = buf;
+    f->writable = 1;
     return f;
 }
 
+CsvFile *csv_open_memory(const char *data, size_t len) {
+    CsvFile *s = (CsvFile *)calloc(1, sizeof(CsvFile));
+    if (!s) return NULL;
+    s->map = data;
+    s->map_len = len;
+    return s;
+}
+
+FILE *csv_stream(const CsvFile *f) {
+    return f->map ? NULL : f->fp;
+}
+
 void csv_close(CsvFile *f) {
     if (!f) return;
-    if (f->fp) fclose(f->fp);
+    if (f->map && f->owns_map) munmap((void *)f->map, f->map_len);
+    if (f->fp && f->owns_fp) fclose(f->fp);
+    free(f->copy);
     free(f->line);
+    free(f->fields);
+    free(f->spans);
     free(f);
 }
 
@@ -59,6 +219,62 @@ void csv_row_free(CsvRow *row) {
     row->count = 0;
 }
 
+// Points f->cur at the next line of the mapping. Returns its length
+// including any line terminator, -1 at the end of the mapping, or -2 if
+// the line buffer could not grow.
+// csv_open_copy's buffer is tokenized where it lies, the '\n' becoming
+// the line's terminator. A file mapping is read-only and copied line by
+// line: writing to a private mapping would copy every page it touches
+// instead, in the kernel and into file-sized anonymous memory, for no
+// gain the bench can measure. A last line with no '\n' is copied too.
+static ssize_t map_getline(CsvFile *f) {
+    if (f->map_pos >= f->map_len) return -1;
+
+    const char *start = f->map + f->map_pos;
+    size_t avail = f->map_len - f->map_pos;
+    const char *nl = (const char *)memchr(start, '\n', avail);
+    size_t n = nl ? (size_t)(nl - start) + 1 : avail;
+
+    if (f->writable && nl) {
+        f->cur = (char *)start;
+        f->map_pos += n;
+        return (ssize_t)n;
+    }
+
+    if (n + 1 > f->linecap) {
+        size_t newcap = (f->linecap == 0) ? 256 : f->linecap;
+        while (newcap < n + 1) newcap *= 2;
+        char *nb = (char *)realloc(f->line, newcap);
+        if (!nb) return -2;
+        f->line = nb;
+        f->linecap = newcap;
+    }
+    memcpy(f->line, start, n);
+    f->line[n] = '\0';
+    f->cur = f->line;
+    f->map_pos += n;
+    return (ssize_t)n;
+}
+
+// Reads the next line into f->cur and strips the newline(s).
+// Returns the remaining length, -1 at EOF, or -2 on error.
+static ssize_t next_line(CsvFile *f) {
+    ssize_t got;
+    if (f->map) {
+        got = map_getline(f);
+    } else {
+        got = getline(&f->line, &f->linecap, f->fp);
+        f->cur = f->line;
+    }
+    if (got < 0) return (got == -2) ? -2 : -1;
+    STATS_ADD(STAT_BYTES_READ, got);
+
+    while (got > 0 && (f->cur[got - 1] == '\n' || f->cur[got - 1] == '\r')) {
+        f->cur[--got] = '\0';
+    }
+    return got;
+}
+
 static int push_field(CsvRow *row, char *field) {
     char **nf = (char **)realloc(row->fields, (row->count + 1) * sizeof(char *));
     if (!nf) return 0;
@@ -72,15 +288,11 @@ int csv_read_row(CsvFile *f, CsvRow *out) {
     out->fields = NULL;
     out->count = 0;
 
-    ssize_t got = getline(&f->line, &f->linecap, f->fp);
+    ssize_t got = next_line(f);
+    if (got == -2) return -1;
     if (got < 0) return 0; // EOF
 
-    // Strip newline(s)
-    while (got > 0 && (f->line[got - 1] == '\n' || f->line[got - 1] == '\r')) {
-        f->line[--got] = '\0';
-    }
-
-    const char *p = f->line;
+    const char *p = f->cur;
     while (*p) {
         // Parse one field
         if (*p == '"') {
@@ -148,11 +360,128 @@ int csv_read_row(CsvFile *f, CsvRow *out) {
     }
 
     // Handle trailing comma -> empty last field (e.g. "a,b,")
-    if (got > 0 && f->line[got - 1] == ',') {
+    if (got > 0 && f->cur[got - 1] == ',') {
         char *field = (char *)calloc(1, 1);
         if (!field) { csv_row_free(out); return -1; }
         if (!push_field(out, field)) { free(field); csv_row_free(out); return -1; }
     }
 
+    STATS_INC(STAT_ROWS_PARSED);
+    STATS_ADD(STAT_FIELDS_ALLOCATED, out->count);
+    return 1;
+}
+
+/* -------------------- Zero-copy reader -------------------- */
+
+static int view_push(CsvFile *f, CsvRow *out, char *field) {
+    if (out->count == f->fieldcap) {
+        size_t newcap = (f->fieldcap == 0) ? 16 : f->fieldcap * 2;
+        char **nf = (char **)realloc(f->fields, newcap * sizeof(char *));
+        if (!nf) return 0;
+        f->fields = nf;
+        f->fieldcap = newcap;
+    }
+    f->fields[out->count++] = field;
+    return 1;
+}
+
+// Terminates [start, end) with surrounding whitespace removed.
+static char *trim_span(char *start, char *end) {
+    while (start < end && isspace((unsigned char)*start)) start++;
+    while (end > start && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return start;
+}
+
+// Fast path for lines with no quotes: scan_fields finds every comma and
+// trims every field in one pass, so all that is left is terminating them.
+// Returns 0 if the line needs the quote-aware tokenizer.
+static int split_unquoted(CsvFile *f, char *line, size_t len, CsvRow *out) {
+    size_t n = scan_fields(line, len, f->spans, f->spancap);
+    if (n == SCAN_SLOW) return 0;
+
+    if (n > f->spancap) {
+        size_t newcap = (f->spancap == 0) ? 16 : f->spancap;
+        while (newcap < n) newcap *= 2;
+        ScanSpan *ns = (ScanSpan *)realloc(f->spans, newcap * sizeof(ScanSpan));
+        if (!ns) return -1;
+        f->spans = ns;
+        f->spancap = newcap;
+        n = scan_fields(line, len, f->spans, f->spancap);
+    }
+
+    // Last field is empty when the line ends with a comma
+    for (size_t k = 0; k < n; k++) {
+        line[f->spans[k].end] = '\0';
+        if (!view_push(f, out, line + f->spans[k].begin)) return -1;
+    }
+    return 1;
+}
+
+// Splits line[0..len) in place, following the same rules as csv_read_row:
+// quoted fields are unescaped over their own bytes, unquoted fields are
+// trimmed by moving the start pointer and writing a new terminator.
+static int tokenize_in_place(CsvFile *f, char *line, size_t len, CsvRow *out) {
+    out->count = 0;
+
+    if (len > 0) {
+        int rc = split_unquoted(f, line, len, out);
+        if (rc < 0) return -1;
+        if (rc > 0) {
+            out->fields = f->fields;
+            return 1;
+        }
+    }
+
+    int trailing_comma = (len > 0 && line[len - 1] == ',');
+
+    char *p = line;
+    while (*p) {
+        if (*p == '"') {
+            p++; // skip opening quote
+            char *field = p;
+            char *w = p;
+
+            while (*p) {
+                if (*p == '"' && p[1] == '"') { *w++ = '"'; p += 2; continue; }
+                if (*p == '"') break;
+                *w++ = *p++;
+            }
+            if (*p == '"') p++; // closing quote
+
+            // after quoted field, consume optional whitespace then optional comma
+            while (*p && isspace((unsigned char)*p)) p++;
+            if (*p == ',') p++;
+
+            *w = '\0';
+            if (!view_push(f, out, field)) return -1;
+        } else {
+            char *start = p;
+            while (*p && *p != ',') p++;
+            char *end = p;
+            if (*p == ',') p++;
+
+            if (!view_push(f, out, trim_span(start, end))) return -1;
+        }
+    }
+
+    // Trailing comma -> empty last field; point it at the line terminator
+    if (trailing_comma && !view_push(f, out, line + len)) return -1;
+
+    out->fields = f->fields;
     return 1;
 }
+
+int csv_read_row_view(CsvFile *f, CsvRow *out) {
+    if (!f || !out) return -1;
+    out->fields = NULL;
+    out->count = 0;
+
+    ssize_t got = next_line(f);
+    if (got == -2) return -1;
+    if (got < 0) return 0; // EOF
+
+    int rc = tokenize_in_place(f, f->cur, (size_t)got, out);
+    if (rc > 0) STATS_INC(STAT_ROWS_PARSED);
+    return rc;
+}
@@ -1,72 +1,416 @@
 #include "grades.h"
+#include "stats.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* -------------------- Storage -------------------- */
+
+// Every allocation goes through these so a list can live in an arena
+
+static void *mem_alloc(Arena *a, size_t n) {
+    return a ? arena_alloc(a, n) : malloc(n);
+}
+
+static void *mem_calloc(Arena *a, size_t count, size_t size) {
+    if (!a) return calloc(count, size);
+    void *p = arena_alloc(a, count * size);
+    if (p) memset(p, 0, count * size);
+    return p;
+}
+
+static void *mem_realloc(Arena *a, void *p, size_t old_size, size_t new_size) {
+    return a ? arena_realloc(a, p, old_size, new_size) : realloc(p, new_size);
+}
+
+static void mem_release(Arena *a, void *p) {
+    if (!a) free(p);
+}
+
+/* -------------------- Hash index helpers -------------------- */
+
+static size_t hash_id(int id) {
+    unsigned long long h = (unsigned int)id;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h ^ (h >> 32));
+}
+
+static size_t hash_name(const char *s) {
+    unsigned long long h = 1469598103934665603ULL; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+// Tables are kept at most half full and sized to a power of two.
+static size_t index_capacity_for(size_t count) {
+    size_t cap = 16;
+    while (cap < count * 2) cap *= 2;
+    return cap;
+}
+
+static void id_index_insert(ModuleList *list, size_t idx) {
+    size_t mask = list->id_cap - 1;
+    size_t s = hash_id(list->items[idx].id) & mask;
+    while (list->id_slots[s] != 0) {
+        // keep the first module with a given id, as the linear scan did
+        if (list->items[list->id_slots[s] - 1].id == list->items[idx].id) return;
+        s = (s + 1) & mask;
+    }
+    list->id_slots[s] = idx + 1;
+}
+
+static int id_index_rebuild(ModuleList *list, size_t want) {
+    size_t cap = index_capacity_for(want);
+    size_t *slots = mem_calloc(list->arena, cap, sizeof(size_t));
+    if (!slots) return 0;
+    mem_release(list->arena, list->id_slots);
+    list->id_slots = slots;
+    list->id_cap = cap;
+    for (size_t i = 0; i < list->count; i++) id_index_insert(list, i);
+    return 1;
+}
+
+static void name_index_insert(Module *m, size_t idx) {
+    size_t mask = m->name_cap - 1;
+    const char *name = m->components[idx].name;
+    size_t s = hash_name(name) & mask;
+    while (m->name_slots[s] != 0) {
+        if (strcmp(m->components[m->name_slots[s] - 1].name, name) == 0) return;
+        s = (s + 1) & mask;
+    }
+    m->name_slots[s] = idx + 1;
+}
+
+static int name_index_rebuild(Module *m, size_t want) {
+    size_t cap = index_capacity_for(want);
+    size_t *slots = mem_calloc(m->arena, cap, sizeof(size_t));
+    if (!slots) return 0;
+    mem_release(m->arena, m->name_slots);
+    m->name_slots = slots;
+    m->name_cap = cap;
+    for (size_t i = 0; i < m->component_count; i++) name_index_insert(m, i);
+    return 1;
+}
+
+/* -------------------- Module list -------------------- */
+
 void module_list_init(ModuleList *list) {
     list->items = NULL;
     list->count = 0;
     list->capacity = 0;
+    list->id_slots = NULL;
+    list->id_cap = 0;
+    list->component_refs = NULL;
+    list->component_total = 0;
+    list->component_slots = NULL;
+    list->component_cap = 0;
+    list->arena = NULL;
+}
+
+int module_list_init_arena(ModuleList *list, size_t size_hint) {
+    module_list_init(list);
+    list->arena = malloc(sizeof(Arena));
+    if (!list->arena) return 0;
+    arena_init(list->arena, size_hint);
+    return 1;
+}
+
+// Room for the final arrays plus the copies left behind by doubling
+size_t module_list_arena_hint(size_t module_rows, size_t component_rows) {
+    size_t per_module = 4 * sizeof(Module) + 4 * sizeof(size_t);
+    size_t per_component = 4 * sizeof(Component) + 4 * sizeof(size_t) +
+                           sizeof(int) + sizeof(ComponentGroup) + sizeof(size_t) +
+                           sizeof(ComponentRef) + 2 * sizeof(size_t);
+    return module_rows * per_module + component_rows * per_component;
 }
 
 static void module_init(Module *m) {
     m->components = NULL;
     m->component_count = 0;
     m->component_capacity = 0;
+    m->name_slots = NULL;
+    m->name_cap = 0;
+    m->component_group = NULL;
+    m->groups = NULL;
+    m->group_count = 0;
+    m->group_members = NULL;
+    m->max_group_size = 0;
+    m->arena = NULL;
 }
 
 static void module_free(Module *m) {
     free(m->components);
-    m->components = NULL;
-    m->component_count = 0;
-    m->component_capacity = 0;
+    free(m->name_slots);
+    module_free_groups(m);
+    module_init(m);
 }
 
 void module_list_free(ModuleList *list) {
     if (!list) return;
+    if (list->arena) {
+        arena_free(list->arena);
+        free(list->arena);
+        module_list_init(list);
+        return;
+    }
     for (size_t i = 0; i < list->count; i++) {
         module_free(&list->items[i]);
     }
     free(list->items);
-    list->items = NULL;
-    list->count = 0;
-    list->capacity = 0;
+    free(list->id_slots);
+    free(list->component_refs);
+    free(list->component_slots);
+    module_list_init(list);
 }
 
 int module_list_push(ModuleList *list, const Module *m) {
     if (list->count == list->capacity) {
         size_t newcap = (list->capacity == 0) ? 8 : list->capacity * 2;
-        Module *newitems = realloc(list->items, newcap * sizeof(Module));
+        Module *newitems = mem_realloc(list->arena, list->items,
+                                       list->capacity * sizeof(Module), newcap * sizeof(Module));
         if (!newitems) return 0;
         list->items = newitems;
         list->capacity = newcap;
     }
+    if ((list->count + 1) * 2 > list->id_cap) {
+        if (!id_index_rebuild(list, list->count + 1)) return 0;
+    }
     list->items[list->count] = *m;
     module_init(&list->items[list->count]);
+    list->items[list->count].arena = list->arena;
+    id_index_insert(list, list->count);
     list->count++;
     return 1;
 }
 
+int module_list_reserve(ModuleList *list, size_t n) {
+    if (n > list->capacity) {
+        Module *newitems = mem_realloc(list->arena, list->items,
+                                       list->capacity * sizeof(Module), n * sizeof(Module));
+        if (!newitems) return 0;
+        list->items = newitems;
+        list->capacity = n;
+    }
+    if (n * 2 > list->id_cap) return id_index_rebuild(list, n);
+    return 1;
+}
+
 Module *module_list_find_by_id(ModuleList *list, int id) {
-    for (size_t i = 0; i < list->count; i++)
-        if (list->items[i].id == id) return &list->items[i];
+    STATS_INC(STAT_HASH_LOOKUPS);
+    if (list->id_cap == 0) return NULL;
+    size_t mask = list->id_cap - 1;
+    for (size_t s = hash_id(id) & mask; list->id_slots[s] != 0; s = (s + 1) & mask) {
+        STATS_INC(STAT_HASH_PROBES);
+        Module *m = &list->items[list->id_slots[s] - 1];
+        if (m->id == id) return m;
+    }
     return NULL;
 }
 
 Component *module_find_component_by_name(Module *m, const char *name) {
-    for (size_t i = 0; i < m->component_count; i++)
-        if (strcmp(m->components[i].name, name) == 0)
-            return &m->components[i];
+    STATS_INC(STAT_HASH_LOOKUPS);
+    if (m->name_cap == 0) return NULL;
+    size_t mask = m->name_cap - 1;
+    for (size_t s = hash_name(name) & mask; m->name_slots[s] != 0; s = (s + 1) & mask) {
+        STATS_INC(STAT_HASH_PROBES);
+        Component *c = &m->components[m->name_slots[s] - 1];
+        if (strcmp(c->name, name) == 0) return c;
+    }
     return NULL;
 }
 
+int module_reserve_components(Module *m, size_t n) {
+    if (n > m->component_capacity) {
+        Component *newitems = mem_realloc(m->arena, m->components,
+                                          m->component_capacity * sizeof(Component),
+                                          n * sizeof(Component));
+        if (!newitems) return 0;
+        m->components = newitems;
+        m->component_capacity = n;
+    }
+    if (n * 2 > m->name_cap) return name_index_rebuild(m, n);
+    return 1;
+}
+
 int module_add_component(Module *m, const Component *c) {
+    module_free_groups(m);
+
     if (m->component_count == m->component_capacity) {
         size_t newcap = (m->component_capacity == 0) ? 4 : m->component_capacity * 2;
-        Component *newitems = realloc(m->components, newcap * sizeof(Component));
+        Component *newitems = mem_realloc(m->arena, m->components,
+                                          m->component_capacity * sizeof(Component),
+                                          newcap * sizeof(Component));
         if (!newitems) return 0;
         m->components = newitems;
         m->component_capacity = newcap;
     }
-    m->components[m->component_count++] = *c;
+    if ((m->component_count + 1) * 2 > m->name_cap) {
+        if (!name_index_rebuild(m, m->component_count + 1)) return 0;
+    }
+    m->components[m->component_count] = *c;
+    name_index_insert(m, m->component_count);
+    m->component_count++;
+    return 1;
+}
+
+/* -------------------- Best-of group table -------------------- */
+
+void module_free_groups(Module *m) {
+    mem_release(m->arena, m->component_group);
+    mem_release(m->arena, m->groups);
+    mem_release(m->arena, m->group_members);
+    m->component_group = NULL;
+    m->groups = NULL;
+    m->group_count = 0;
+    m->group_members = NULL;
+    m->max_group_size = 0;
+}
+
+int module_build_groups(Module *m) {
+    module_free_groups(m);
+
+    size_t n = m->component_count;
+    m->component_group = mem_alloc(m->arena, (n ? n : 1) * sizeof(int));
+    m->groups = mem_alloc(m->arena, (n ? n : 1) * sizeof(ComponentGroup));
+    m->group_members = mem_alloc(m->arena, (n ? n : 1) * sizeof(size_t));
+    if (!m->component_group || !m->groups || !m->group_members) {
+        module_free_groups(m);
+        return 0;
+    }
+
+    // Assign groups in order of first appearance
+    for (size_t i = 0; i < n; i++) {
+        const Component *c = &m->components[i];
+        if (c->group_id == 0 || c->best_of == 0) {
+            m->component_group[i] = -1;
+            continue;
+        }
+
+        size_t g = 0;
+        while (g < m->group_count &&
+               (m->groups[g].group_id != c->group_id || m->groups[g].best_of != c->best_of)) g++;
+
+        if (g == m->group_count) {
+            m->groups[g] = (ComponentGroup){ c->group_id, c->best_of, -1.0, i, 0, 0 };
+            m->group_count++;
+        }
+        // first non-negative member weight, as the per-call scan used
+        if (m->groups[g].item_weight < 0.0) m->groups[g].item_weight = c->weight;
+        m->groups[g].member_count++;
+        m->component_group[i] = (int)g;
+    }
+
+    // Lay the members out contiguously, in component order within a group
+    size_t at = 0;
+    for (size_t g = 0; g < m->group_count; g++) {
+        m->groups[g].member_start = at;
+        at += m->groups[g].member_count;
+        if (m->groups[g].member_count > m->max_group_size)
+            m->max_group_size = m->groups[g].member_count;
+        m->groups[g].member_count = 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int g = m->component_group[i];
+        if (g < 0) continue;
+        ComponentGroup *grp = &m->groups[g];
+        m->group_members[grp->member_start + grp->member_count++] = i;
+    }
+    return 1;
+}
+
+/* -------------------- Component dictionary -------------------- */
+
+static size_t hash_component(int module_id, const char *name) {
+    return hash_name(name) ^ hash_id(module_id);
+}
+
+int module_list_index_components(ModuleList *list) {
+    size_t total = 0;
+    for (size_t i = 0; i < list->count; i++) total += list->items[i].component_count;
+
+    size_t cap = index_capacity_for(total);
+    ComponentRef *refs = mem_alloc(list->arena, (total ? total : 1) * sizeof(ComponentRef));
+    size_t *slots = mem_calloc(list->arena, cap, sizeof(size_t));
+    if (!refs || !slots) {
+        mem_release(list->arena, refs);
+        mem_release(list->arena, slots);
+        return 0;
+    }
+    mem_release(list->arena, list->component_refs);
+    mem_release(list->arena, list->component_slots);
+    list->component_refs = refs;
+    list->component_total = total;
+    list->component_slots = slots;
+    list->component_cap = cap;
+
+    size_t mask = cap - 1, id = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        const Module *m = &list->items[i];
+        // a repeated module id only ever resolves to its first module
+        int canonical = module_list_find_by_id(list, m->id) == m;
+        for (size_t j = 0; j < m->component_count; j++, id++) {
+            refs[id] = (ComponentRef){ i, j, m->id, 0 };
+            if (!canonical) continue;
+
+            const char *name = m->components[j].name;
+            size_t s = hash_component(m->id, name) & mask;
+            int dup = 0;
+            for (; slots[s] != 0; s = (s + 1) & mask) {
+                const ComponentRef *r = &refs[slots[s] - 1];
+                if (r->module_id == m->id && strcmp(list->items[r->module].components[r->component].name, name) == 0) {
+                    dup = 1;  // first component with a name wins, as in the module index
+                    break;
+                }
+            }
+            if (!dup) {
+                slots[s] = id + 1;
+                refs[id].named = 1;
+            }
+        }
+    }
+    return 1;
+}
+
+long module_list_component_id(const ModuleList *list, int module_id, const char *name) {
+    STATS_INC(STAT_HASH_LOOKUPS);
+    if (list->component_cap == 0) return -1;
+    size_t mask = list->component_cap - 1;
+    for (size_t s = hash_component(module_id, name) & mask; list->component_slots[s] != 0; s = (s + 1) & mask) {
+        STATS_INC(STAT_HASH_PROBES);
+        size_t id = list->component_slots[s] - 1;
+        const ComponentRef *r = &list->component_refs[id];
+        if (r->module_id == module_id &&
+            strcmp(list->items[r->module].components[r->component].name, name) == 0) return (long)id;
+    }
+    return -1;
+}
+
+Component *module_list_component(ModuleList *list, size_t id, Module **m) {
+    if (id >= list->component_total) return NULL;
+    const ComponentRef *r = &list->component_refs[id];
+    if (m) *m = &list->items[r->module];
+    return &list->items[r->module].components[r->component];
+}
+
+void module_list_dictionary_tag(const ModuleList *list, char tag[DICTIONARY_TAG_MAX]) {
+    unsigned long long h = 1469598103934665603ULL; // FNV-1a
+    char num[16];
+    for (size_t id = 0; id < list->component_total; id++) {
+        const ComponentRef *r = &list->component_refs[id];
+        snprintf(num, sizeof num, "%d,", r->module_id);
+        for (const char *p = num; *p; p++) h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+        for (const char *p = list->items[r->module].components[r->component].name; *p; p++)
+            h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+        h = (h ^ '\n') * 1099511628211ULL;
+    }
+    snprintf(tag, DICTIONARY_TAG_MAX, "%zu:%016llx", list->component_total, h);
+}
+
+int module_list_build_groups(ModuleList *list) {
+    for (size_t i = 0; i < list->count; i++)
+        if (!module_build_groups(&list->items[i])) return 0;
     return 1;
 }
@@ -1,45 +1,56 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <float.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
+#include "arena.h"
 #include "csv.h"
 #include "grades.h"
+#include "cohort.h"
+#include "columns.h"
 #include "io.h"
+#include "num.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "stats.h"
 
-/* -------------------- Parsing helpers -------------------- */
-
-static int parse_int(const char *s, int *out) {
-    if (!s || !*s) return 0;
-    char *end = NULL;
-    long v = strtol(s, &end, 10);
-    if (*end != '\0') return 0;
-    *out = (int)v;
-    return 1;
-}
+/* -------------------- CSV loaders -------------------- */
 
-static int parse_double(const char *s, double *out) {
-    if (!s || !*s) return 0;
-    char *end = NULL;
-    double v = strtod(s, &end);
-    if (*end != '\0') return 0;
-    *out = v;
-    return 1;
+// Doubles an array of elem-sized items; NULL if out of memory (the old
+// array is still valid then)
+static void *grow_items(void *items, size_t *cap, size_t elem) {
+    size_t newcap = *cap ? *cap * 2 : 1024;
+    void *p = realloc(items, newcap * elem);
+    if (p) *cap = newcap;
+    return p;
 }
 
-/* -------------------- CSV loaders -------------------- */
+// csv_open_mmap at startup, csv_open_copy for a live reload
+typedef CsvFile *(*CsvOpenFn)(const char *path);
 
-int load_modules(ModuleList *modules, const char *path) {
-    CsvFile *cf = csv_open(path);
+static int read_modules(ModuleList *modules, const char *path, CsvOpenFn open_csv) {
+    CsvFile *cf = open_csv(path);
     if (!cf) {
         fprintf(stderr, "Failed to open %s\n", path);
         return 0;
     }
 
+    if (!module_list_reserve(modules, modules->count + csv_count_lines(cf))) {
+        fprintf(stderr, "Out of memory adding module\n");
+        csv_close(cf);
+        return 0;
+    }
+
     CsvRow row;
     int first = 1;
 
     while (1) {
-        int rc = csv_read_row(cf, &row);
+        int rc = csv_read_row_view(cf, &row);
         if (rc == 0) break;
         if (rc < 0) {
             fprintf(stderr, "CSV read error in %s\n", path);
@@ -47,13 +58,12 @@ int load_modules(ModuleList *modules, const char *path) {
             return 0;
         }
 
-        if (first) { first = 0; csv_row_free(&row); continue; }
-        if (row.count < 4) { csv_row_free(&row); continue; }
+        if (first) { first = 0; continue; }
+        if (row.count < 4) continue;
 
         Module m = (Module){0};
         if (!parse_int(row.fields[0], &m.id) ||
             !parse_int(row.fields[3], &m.credits)) {
-            csv_row_free(&row);
             continue;
         }
 
@@ -62,18 +72,22 @@ int load_modules(ModuleList *modules, const char *path) {
 
         if (!module_list_push(modules, &m)) {
             fprintf(stderr, "Out of memory adding module\n");
-            csv_row_free(&row);
             csv_close(cf);
             return 0;
         }
-
-        csv_row_free(&row);
     }
 
     csv_close(cf);
     return 1;
 }
 
+int load_modules(ModuleList *modules, const char *path) {
+    STATS_PHASE_BEGIN(t0);
+    int ok = read_modules(modules, path, csv_open_mmap);
+    STATS_PHASE_END(STAT_PHASE_LOAD_MODULES, t0);
+    return ok;
+}
+
 /*
 components.csv supported formats:
 
@@ -83,82 +97,556 @@ OLD:
 NEW (optional, for best-of-N grouping):
   module_id,component_name,weight,group_id,best_of
 */
-int load_components(ModuleList *modules, const char *path) {
-    CsvFile *cf = csv_open(path);
+// A parsed components.csv row waiting for its module's storage
+typedef struct {
+    size_t module;
+    Component c;
+} StagedComponent;
+
+// One parse into a staging array sized from the line count (memchr only),
+// counting rows per module; then each module's components are reserved
+// exactly once and added in file order.
+static int read_components(ModuleList *modules, const char *path, CsvOpenFn open_csv) {
+    CsvFile *cf = open_csv(path);
     if (!cf) {
         fprintf(stderr, "Failed to open %s\n", path);
         return 0;
     }
 
+    size_t cap = csv_count_lines(cf), count = 0;
+    StagedComponent *staged = cap ? malloc(cap * sizeof *staged) : NULL;
+    size_t *per_module = calloc(modules->count ? modules->count : 1, sizeof(size_t));
+    if ((cap && !staged) || !per_module) {
+        fprintf(stderr, "Out of memory adding component\n");
+        free(staged);
+        free(per_module);
+        csv_close(cf);
+        return 0;
+    }
+
     CsvRow row;
     int first = 1;
+    int rc;
 
-    while (1) {
-        int rc = csv_read_row(cf, &row);
-        if (rc == 0) break;
-        if (rc < 0) {
-            fprintf(stderr, "CSV read error in %s\n", path);
-            csv_close(cf);
-            return 0;
-        }
-
-        if (first) { first = 0; csv_row_free(&row); continue; }
-        if (row.count < 3) { csv_row_free(&row); continue; }
+    while ((rc = csv_read_row_view(cf, &row)) > 0) {
+        if (first) { first = 0; continue; }
+        if (row.count < 3) continue;
 
         int module_id = 0;
         double weight = 0.0;
 
         if (!parse_int(row.fields[0], &module_id) ||
             !parse_double(row.fields[2], &weight)) {
-            csv_row_free(&row);
             continue;
         }
 
         Module *m = module_list_find_by_id(modules, module_id);
         if (!m) {
             fprintf(stderr, "Warning: component refers to unknown module_id %d\n", module_id);
-            csv_row_free(&row);
             continue;
         }
 
-        Component c = (Component){0};
-        snprintf(c.name, sizeof c.name, "%s", row.fields[1]);
-        c.weight = weight;
-        c.mark = -1.0;
+        if (count == cap) {   // only on the stdio path, where no count was taken
+            StagedComponent *p = grow_items(staged, &cap, sizeof *p);
+            if (!p) { rc = -2; break; }
+            staged = p;
+        }
+        StagedComponent *sc = &staged[count++];
+        sc->module = (size_t)(m - modules->items);
+        per_module[sc->module]++;
+
+        Component *c = &sc->c;
+        *c = (Component){0};
+        snprintf(c->name, sizeof c->name, "%s", row.fields[1]);
+        c->weight = weight;
+        c->mark = -1.0;
 
         // Best-of-N defaults (requires Component to have these fields)
-        c.group_id = 0;
-        c.best_of  = 0;
+        c->group_id = 0;
+        c->best_of  = 0;
 
         if (row.count >= 5) {
-            (void)parse_int(row.fields[3], &c.group_id);
-            (void)parse_int(row.fields[4], &c.best_of);
+            (void)parse_int(row.fields[3], &c->group_id);
+            (void)parse_int(row.fields[4], &c->best_of);
         }
+    }
+    csv_close(cf);
 
-        if (!module_add_component(m, &c)) {
-            fprintf(stderr, "Out of memory adding component\n");
-            csv_row_free(&row);
-            csv_close(cf);
-            return 0;
+    int ok = rc == 0;
+    if (rc == -1) fprintf(stderr, "CSV read error in %s\n", path);
+
+    for (size_t i = 0; i < modules->count && ok; i++) {
+        Module *m = &modules->items[i];
+        ok = module_reserve_components(m, m->component_count + per_module[i]);
+    }
+    for (size_t k = 0; k < count && ok; k++)
+        ok = module_add_component(&modules->items[staged[k].module], &staged[k].c);
+    if (!ok && rc != -1) fprintf(stderr, "Out of memory adding component\n");
+
+    free(staged);
+    free(per_module);
+    if (!ok) return 0;
+
+    if (!module_list_build_groups(modules) || !module_list_index_components(modules)) {
+        fprintf(stderr, "Out of memory building component groups\n");
+        return 0;
+    }
+    return 1;
+}
+
+int load_components(ModuleList *modules, const char *path) {
+    STATS_PHASE_BEGIN(t0);
+    int ok = read_components(modules, path, csv_open_mmap);
+    STATS_PHASE_END(STAT_PHASE_LOAD_COMPONENTS, t0);
+    return ok;
+}
+
+int reload_schema(ModuleList *modules, const char *modules_path, const char *components_path) {
+    return read_modules(modules, modules_path, csv_open_copy) &&
+           read_components(modules, components_path, csv_open_copy);
+}
+
+/* -------------------- Parallel ingest -------------------- */
+
+// Smallest byte range worth a thread; smaller files are parsed inline
+#define INGEST_MIN_CHUNK ((size_t)1 << 20)
+
+// Splits the unread rest of cf into line-aligned byte ranges, about four
+// per thread so stealing can even out the load. Returns the number of
+// ranges, with *bounds holding that many + 1 offsets, or 0 when the file
+// should be parsed on the calling thread (stdio, small, one thread, or no
+// memory for the plan).
+static size_t plan_chunks(const CsvFile *cf, unsigned nthreads, size_t **bounds) {
+    size_t begin = csv_tell(cf), size = csv_mapped_size(cf);
+    if (nthreads < 2 || size <= begin) return 0;
+
+    size_t n = (size_t)nthreads * 4;
+    if (n > (size - begin) / INGEST_MIN_CHUNK) n = (size - begin) / INGEST_MIN_CHUNK;
+    if (n < 2) return 0;
+
+    *bounds = malloc((n + 1) * sizeof(size_t));
+    if (!*bounds) return 0;
+    for (size_t k = 0; k < n; k++)
+        (*bounds)[k] = csv_line_start(cf, begin + (size - begin) / n * k);
+    (*bounds)[n] = size;
+    return n;
+}
+
+// Parses one range into chunk k's own buffers; 0 on failure
+typedef int (*ChunkFn)(void *ctx, size_t k, CsvFile *slice);
+
+typedef struct {
+    const CsvFile *cf;
+    const size_t *bounds;
+    int *ok;
+    ChunkFn fn;
+    void *ctx;
+} ChunkJob;
+
+static void chunk_range(void *ctx, size_t begin, size_t end, unsigned worker) {
+    (void)worker;
+    ChunkJob *job = ctx;
+    for (size_t k = begin; k < end; k++) {
+        CsvFile *slice = csv_open_slice(job->cf, job->bounds[k], job->bounds[k + 1]);
+        job->ok[k] = slice && job->fn(job->ctx, k, slice);
+        csv_close(slice);
+    }
+}
+
+static int run_chunks(const CsvFile *cf, const size_t *bounds, size_t n, unsigned nthreads,
+                      ChunkFn fn, void *ctx) {
+    int *ok = calloc(n, sizeof(int));
+    if (!ok) return 0;
+
+    ChunkJob job = { cf, bounds, ok, fn, ctx };
+    int all = pool_parallel_for(nthreads, n, 1, chunk_range, &job);
+    for (size_t k = 0; k < n && all; k++) all = ok[k];
+    free(ok);
+    return all;
+}
+
+/* -------------------- Marks -------------------- */
+
+typedef struct {
+    Component *c;
+    size_t id;     // component dictionary id of c
+    double mark;   // -1 unsets
+} MarkUpdate;
+
+// Resolves one module_id,component_name,mark row. Returns 1 with *out set
+// when the row changes a mark. With clear_on_empty an empty mark unsets
+// the component (journal rows).
+static int mark_update(ModuleList *modules, const CsvRow *row, int clear_on_empty, MarkUpdate *out) {
+    if (row->count < 3) return 0;
+
+    int module_id = 0;
+    if (!parse_int(row->fields[0], &module_id)) return 0;
+
+    long id = module_list_component_id(modules, module_id, row->fields[1]);
+    if (id < 0) return 0;
+    out->id = (size_t)id;
+    out->c = module_list_component(modules, out->id, NULL);
+
+    if (parse_double(row->fields[2], &out->mark)) return 1;
+    if (clear_on_empty && row->fields[2][0] == '\0') {
+        out->mark = -1.0;
+        return 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    MarkUpdate *items;
+    size_t count, cap;
+} MarkChunk;
+
+typedef struct {
+    ModuleList *modules;
+    int clear_on_empty;
+    MarkChunk *chunks;
+} MarkJob;
+
+static int mark_chunk(void *ctx, size_t k, CsvFile *slice) {
+    MarkJob *job = ctx;
+    MarkChunk *out = &job->chunks[k];
+
+    CsvRow row;
+    int rc;
+    while ((rc = csv_read_row_view(slice, &row)) > 0) {
+        MarkUpdate u;
+        if (!mark_update(job->modules, &row, job->clear_on_empty, &u)) continue;
+        if (out->count == out->cap) {
+            MarkUpdate *p = grow_items(out->items, &out->cap, sizeof *p);
+            if (!p) return 0;
+            out->items = p;
+        }
+        out->items[out->count++] = u;
+    }
+    return rc == 0;
+}
+
+// Resolves the chunks in parallel, then applies them in file order so the
+// last row for a component wins as it does when read in one pass.
+static int apply_marks_chunks(ModuleList *modules, const CsvFile *cf, const size_t *bounds,
+                              size_t n, unsigned nthreads, int clear_on_empty) {
+    MarkJob job = { modules, clear_on_empty, calloc(n, sizeof(MarkChunk)) };
+    if (!job.chunks) return 0;
+
+    int ok = run_chunks(cf, bounds, n, nthreads, mark_chunk, &job);
+    for (size_t k = 0; k < n; k++) {
+        const MarkChunk *mc = &job.chunks[k];
+        for (size_t i = 0; i < mc->count && ok; i++) mc->items[i].c->mark = mc->items[i].mark;
+        free(mc->items);
+    }
+    free(job.chunks);
+    return ok;
+}
+
+// Streams that cannot be mapped (pipes, stdin) go through the pipeline,
+// overlapping the reads with parsing; in STATS builds its stage figures
+// go to stderr.
+static int apply_marks_stream(ModuleList *modules, FILE *in, int clear_on_empty) {
+#ifdef GRADECALC_STATS
+    PipelineStats ps;
+    int ok = pipeline_load_marks(modules, in, clear_on_empty, &ps);
+    pipeline_stats_print(&ps, stderr);
+    return ok;
+#else
+    return pipeline_load_marks(modules, in, clear_on_empty, NULL);
+#endif
+}
+
+// Applies module_id,component_name,mark rows to the loaded components.
+// A large mapped file is resolved on nthreads workers, a stream through
+// the read/tokenize/resolve pipeline.
+static int apply_marks_file(ModuleList *modules, const char *path, int clear_on_empty, unsigned nthreads) {
+    CsvFile *cf = csv_open_mmap(path);
+    if (!cf) return 1;
+
+    CsvRow row;
+    int rc = csv_read_row_view(cf, &row);  // header
+    if (rc > 0) {
+        size_t *bounds = NULL;
+        size_t n = plan_chunks(cf, nthreads, &bounds);
+        if (n) {
+            rc = apply_marks_chunks(modules, cf, bounds, n, nthreads, clear_on_empty) ? 0 : -1;
+            free(bounds);
+        } else if (csv_stream(cf) && nthreads > 1) {
+            rc = apply_marks_stream(modules, csv_stream(cf), clear_on_empty) ? 0 : -1;
+        } else {
+            while ((rc = csv_read_row_view(cf, &row)) > 0) {
+                MarkUpdate u;
+                if (mark_update(modules, &row, clear_on_empty, &u)) u.c->mark = u.mark;
+            }
         }
+    }
+
+    if (rc < 0) fprintf(stderr, "CSV read error in %s\n", path);
+    csv_close(cf);
+    return rc == 0;
+}
+
+static void journal_path(const char *path, char *out, size_t outlen) {
+    snprintf(out, outlen, "%s.journal", path);
+}
+
+/* marks.csv is optional; edits journaled since the last save are replayed on top */
+int load_marks(ModuleList *modules, const char *path, unsigned nthreads) {
+    STATS_PHASE_BEGIN(t0);
+    int ok = apply_marks_file(modules, path, 0, nthreads);
+    if (ok) {
+        char jpath[4096];
+        journal_path(path, jpath, sizeof jpath);
+        ok = apply_marks_file(modules, jpath, 1, 1);
+    }
+    STATS_PHASE_END(STAT_PHASE_LOAD_MARKS, t0);
+    return ok;
+}
+
+int load_marks_values(ModuleList *modules, const char *path, double *values) {
+    CsvFile *cf = csv_open_copy(path);
+    if (!cf) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 0;
+    }
 
-        csv_row_free(&row);
+    CsvRow row;
+    int rc = csv_read_row_view(cf, &row);  // header
+    if (rc > 0) {
+        while ((rc = csv_read_row_view(cf, &row)) > 0) {
+            MarkUpdate u;
+            if (mark_update(modules, &row, 0, &u)) values[u.id] = u.mark;
+        }
     }
 
+    if (rc < 0) fprintf(stderr, "CSV read error in %s\n", path);
     csv_close(cf);
+    return rc == 0;
+}
+
+/*
+Cohort marks file: a header row naming the columns, in any order:
+  student_id,module_id,component_name,mark
+or, referring to components by dictionary id (module_list_component_id):
+  student_id,component_id:<tag>,mark
+where <tag> is the module_list_dictionary_tag the ids were listed under.
+*/
+static int find_column(const CsvRow *header, const char *name) {
+    STATS_INC(STAT_LINEAR_LOOKUPS);
+    for (size_t i = 0; i < header->count; i++)
+        if (strcmp(header->fields[i], name) == 0) return (int)i;
+    return -1;
+}
+
+// A column named name or name:<suffix>; *suffix is NULL for the former
+static int find_tagged_column(const CsvRow *header, const char *name, const char **suffix) {
+    STATS_INC(STAT_LINEAR_LOOKUPS);
+    size_t n = strlen(name);
+    for (size_t i = 0; i < header->count; i++) {
+        const char *f = header->fields[i];
+        if (strncmp(f, name, n) != 0 || (f[n] != '\0' && f[n] != ':')) continue;
+        *suffix = f[n] ? f + n + 1 : NULL;
+        return (int)i;
+    }
+    return -1;
+}
+
+typedef struct {
+    int student, module, name, component, mark;  // component >= 0: id format
+    size_t need;  // highest column used; shorter rows are skipped
+} CohortColumns;
+
+static int cohort_columns(const CsvRow *header, const ModuleList *schema, const char *path,
+                          CohortColumns *col) {
+    const char *tag = NULL;
+    col->student   = find_column(header, "student_id");
+    col->component = find_tagged_column(header, "component_id", &tag);
+    col->module    = col->component < 0 ? find_column(header, "module_id") : -1;
+    col->name      = col->component < 0 ? find_column(header, "component_name") : -1;
+    col->mark      = find_column(header, "mark");
+    if (col->student < 0 || col->mark < 0 ||
+        (col->component < 0 && (col->module < 0 || col->name < 0))) {
+        fprintf(stderr, "%s: header must name student_id, mark and either component_id "
+                        "or module_id and component_name\n", path);
+        return 0;
+    }
+
+    // Ids are positions in one components.csv; refuse them for any other
+    if (col->component >= 0) {
+        char have[DICTIONARY_TAG_MAX];
+        module_list_dictionary_tag(schema, have);
+        if (!tag) {
+            fprintf(stderr, "%s: component_id column needs the dictionary tag, as in "
+                            "component_id:%s (see --component-ids)\n", path, have);
+            return 0;
+        }
+        if (strcmp(tag, have) != 0) {
+            fprintf(stderr, "%s: component ids are for dictionary %s but the loaded "
+                            "components are %s; list them again with --component-ids\n",
+                    path, tag, have);
+            return 0;
+        }
+    }
+
+    col->need = (size_t)col->student;
+    if (col->module > (int)col->need) col->need = (size_t)col->module;
+    if (col->name > (int)col->need) col->need = (size_t)col->name;
+    if (col->component > (int)col->need) col->need = (size_t)col->component;
+    if ((size_t)col->mark > col->need) col->need = (size_t)col->mark;
     return 1;
 }
 
-/* marks.csv is optional */
-int load_marks(ModuleList *modules, const char *path) {
-    CsvFile *cf = csv_open(path);
-    if (!cf) return 1;
+// The component id (which is also the cohort column) a row refers to, or
+// -1 if the row is skipped (its student is then not added either)
+static long cohort_component(const ModuleList *schema, const CohortColumns *col, const CsvRow *row) {
+    if (row->count <= col->need) return -1;
+
+    int id = 0;
+    if (col->component >= 0) {
+        if (!parse_int(row->fields[col->component], &id)) return -1;
+        if (id < 0 || (size_t)id >= schema->component_total) return -1;
+        return schema->component_refs[id].named ? id : -1;   // as a name lookup would
+    }
+
+    if (!parse_int(row->fields[col->module], &id)) return -1;
+    return module_list_component_id(schema, id, row->fields[col->name]);
+}
+
+#define NO_COLUMN ((size_t)-1)
+
+typedef struct {
+    size_t run;       // index into the chunk's student runs
+    size_t column;    // NO_COLUMN: the mark did not parse, only the student is added
+    double mark;
+} CohortCell;
+
+// A chunk's rows, with each run of rows for one student sharing an id
+typedef struct {
+    Arena ids;
+    char **run_id;
+    size_t runs, run_cap;
+    CohortCell *cells;
+    size_t count, cap;
+} CohortChunk;
+
+typedef struct {
+    Cohort *cohort;
+    const CohortColumns *col;
+    CohortChunk *chunks;
+} CohortJob;
+
+static int cohort_chunk(void *ctx, size_t k, CsvFile *slice) {
+    CohortJob *job = ctx;
+    CohortChunk *out = &job->chunks[k];
+    arena_init(&out->ids, 64 * 1024);
 
     CsvRow row;
-    int first = 1;
+    int rc;
+    while ((rc = csv_read_row_view(slice, &row)) > 0) {
+        long id = cohort_component(job->cohort->schema, job->col, &row);
+        if (id < 0) continue;
+
+        const char *sid = row.fields[job->col->student];
+        if (out->runs == 0 || strcmp(out->run_id[out->runs - 1], sid) != 0) {
+            if (out->runs == out->run_cap) {
+                char **p = grow_items(out->run_id, &out->run_cap, sizeof *p);
+                if (!p) return 0;
+                out->run_id = p;
+            }
+            size_t n = strlen(sid) + 1;
+            char *id = arena_alloc(&out->ids, n);
+            if (!id) return 0;
+            memcpy(id, sid, n);
+            out->run_id[out->runs++] = id;
+        }
+
+        if (out->count == out->cap) {
+            CohortCell *p = grow_items(out->cells, &out->cap, sizeof *p);
+            if (!p) return 0;
+            out->cells = p;
+        }
+        CohortCell *cell = &out->cells[out->count++];
+        cell->run = out->runs - 1;
+        cell->column = parse_double(row.fields[job->col->mark], &cell->mark) ? (size_t)id : NO_COLUMN;
+    }
+    return rc == 0;
+}
+
+// Parses the chunks in parallel, then adds students and marks chunk by
+// chunk in file order, so row order and the last mark for a cell match a
+// single pass.
+static int load_cohort_chunks(Cohort *cohort, const CohortColumns *col, const CsvFile *cf,
+                              const size_t *bounds, size_t n, unsigned nthreads, const char *path) {
+    CohortJob job = { cohort, col, calloc(n, sizeof(CohortChunk)) };
+    if (!job.chunks) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+
+    int ok = run_chunks(cf, bounds, n, nthreads, cohort_chunk, &job);
+    if (!ok) fprintf(stderr, "CSV read error in %s\n", path);
+
+    for (size_t k = 0; k < n; k++) {
+        CohortChunk *ch = &job.chunks[k];
+        long *student = ok ? malloc((ch->runs ? ch->runs : 1) * sizeof(long)) : NULL;
+        if (ok && !student) {
+            fprintf(stderr, "Out of memory\n");
+            ok = 0;
+        }
+        for (size_t r = 0; r < ch->runs && ok; r++) {
+            student[r] = cohort_student(cohort, ch->run_id[r]);
+            if (student[r] < 0) {
+                fprintf(stderr, "Out of memory adding student\n");
+                ok = 0;
+            }
+        }
+        for (size_t i = 0; i < ch->count && ok; i++) {
+            const CohortCell *cell = &ch->cells[i];
+            if (cell->column != NO_COLUMN)
+                cohort_row(cohort, (size_t)student[cell->run])[cell->column] = cell->mark;
+        }
+
+        free(student);
+        free(ch->run_id);
+        free(ch->cells);
+        arena_free(&ch->ids);
+    }
+    free(job.chunks);
+    return ok;
+}
+
+int load_cohort_marks(Cohort *cohort, const char *path, unsigned nthreads) {
+    CsvFile *cf = csv_open_mmap(path);
+    if (!cf) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 0;
+    }
+
+    CsvRow row;
+    int rc = csv_read_row_view(cf, &row);
+    if (rc <= 0) {
+        fprintf(stderr, "%s: missing header row\n", path);
+        csv_close(cf);
+        return 0;
+    }
+
+    CohortColumns col;
+    if (!cohort_columns(&row, cohort->schema, path, &col)) {
+        csv_close(cf);
+        return 0;
+    }
+
+    size_t *bounds = NULL;
+    size_t n = plan_chunks(cf, nthreads, &bounds);
+    if (n) {
+        int ok = load_cohort_chunks(cohort, &col, cf, bounds, n, nthreads, path);
+        free(bounds);
+        csv_close(cf);
+        return ok;
+    }
 
     while (1) {
-        int rc = csv_read_row(cf, &row);
+        rc = csv_read_row_view(cf, &row);
         if (rc == 0) break;
         if (rc < 0) {
             fprintf(stderr, "CSV read error in %s\n", path);
@@ -166,56 +654,401 @@ int load_marks(ModuleList *modules, const char *path) {
             return 0;
         }
 
-        if (first) { first = 0; csv_row_free(&row); continue; }
-        if (row.count < 3) { csv_row_free(&row); continue; }
+        long id = cohort_component(cohort->schema, &col, &row);
+        if (id < 0) continue;
+
+        long s = cohort_student(cohort, row.fields[col.student]);
+        if (s < 0) {
+            fprintf(stderr, "Out of memory adding student\n");
+            csv_close(cf);
+            return 0;
+        }
+
+        double mark = 0.0;
+        if (parse_double(row.fields[col.mark], &mark)) {
+            cohort_row(cohort, (size_t)s)[id] = mark;
+        }
+    }
+
+    csv_close(cf);
+    return 1;
+}
+
+/* -------------------- Monte Carlo priors -------------------- */
+
+// One mean or sd cell: 0 if absent or empty (the default stands), 1 if
+// *out was set, -1 if it is not a number in [lo, hi]
+static int prior_value(const CsvRow *row, int col, double lo, double hi, double *out) {
+    if (col < 0 || (size_t)col >= row->count || row->fields[col][0] == '\0') return 0;
+    double v;
+    if (!parse_double(row->fields[col], &v) || !(v >= lo && v <= hi)) return -1;
+    *out = v;
+    return 1;
+}
+
+int load_mc_priors(McPriors *priors, ModuleList *modules, const char *path) {
+    CsvFile *cf = csv_open_mmap(path);
+    if (!cf) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 0;
+    }
+
+    CsvRow row;
+    if (csv_read_row_view(cf, &row) <= 0) {
+        fprintf(stderr, "%s: missing header row\n", path);
+        csv_close(cf);
+        return 0;
+    }
+
+    int col_module = find_column(&row, "module_id");
+    int col_name   = find_column(&row, "component_name");
+    int col_mean   = find_column(&row, "mean");
+    int col_sd     = find_column(&row, "sd");
+    if (col_module < 0 || col_name < 0 || (col_mean < 0 && col_sd < 0)) {
+        fprintf(stderr, "%s: header must name module_id, component_name and mean and/or sd\n", path);
+        csv_close(cf);
+        return 0;
+    }
+
+    int rc;
+    while ((rc = csv_read_row_view(cf, &row)) > 0) {
+        if ((size_t)col_module >= row.count || (size_t)col_name >= row.count) continue;
 
         int module_id = 0;
-        if (!parse_int(row.fields[0], &module_id)) {
-            csv_row_free(&row);
-            continue;
+        if (!parse_int(row.fields[col_module], &module_id)) continue;
+
+        long id = module_list_component_id(modules, module_id, row.fields[col_name]);
+        if (id < 0) continue;
+
+        size_t j = (size_t)id;  // priors are flattened in component id order
+        if (prior_value(&row, col_mean, 0.0, 100.0, &priors->mean[j]) < 0 ||
+            prior_value(&row, col_sd, 0.0, DBL_MAX, &priors->sd[j]) < 0) {
+            fprintf(stderr, "%s: module %d component '%s': mean must be 0 to 100 and sd "
+                    "a number from 0\n", path, module_id, row.fields[col_name]);
+            csv_close(cf);
+            return 0;
         }
+    }
 
-        Module *m = module_list_find_by_id(modules, module_id);
-        if (!m) { csv_row_free(&row); continue; }
+    if (rc < 0) fprintf(stderr, "CSV read error in %s\n", path);
+    csv_close(cf);
+    return rc == 0;
+}
 
-        Component *c = module_find_component_by_name(m, row.fields[1]);
-        if (!c) { csv_row_free(&row); continue; }
+/* -------------------- Streaming cohort report -------------------- */
 
-        double mark = 0.0;
-        if (parse_double(row.fields[2], &mark)) {
-            c->mark = mark;
+// Ids of the students already written, to catch input not grouped by
+// student: open addressing, ids copied into an arena
+typedef struct {
+    Arena ids;
+    char **slots;   // NULL = empty
+    size_t cap, count;
+} IdSet;
+
+static size_t hash_sid(const char *s) {
+    unsigned long long h = 1469598103934665603ULL; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+static int idset_has(const IdSet *set, const char *id) {
+    if (set->cap == 0) return 0;
+    size_t mask = set->cap - 1;
+    for (size_t s = hash_sid(id) & mask; set->slots[s]; s = (s + 1) & mask)
+        if (strcmp(set->slots[s], id) == 0) return 1;
+    return 0;
+}
+
+static int idset_add(IdSet *set, const char *id) {
+    if ((set->count + 1) * 2 > set->cap) {
+        size_t cap = set->cap ? set->cap * 2 : 1024;
+        char **slots = calloc(cap, sizeof *slots);
+        if (!slots) return 0;
+        for (size_t i = 0; i < set->cap; i++) {
+            if (!set->slots[i]) continue;
+            size_t s = hash_sid(set->slots[i]) & (cap - 1);
+            while (slots[s]) s = (s + 1) & (cap - 1);
+            slots[s] = set->slots[i];
         }
+        free(set->slots);
+        set->slots = slots;
+        set->cap = cap;
+    }
+
+    size_t n = strlen(id) + 1;
+    char *copy = arena_alloc(&set->ids, n);
+    if (!copy) return 0;
+    memcpy(copy, id, n);
 
-        csv_row_free(&row);
+    size_t mask = set->cap - 1;
+    size_t s = hash_sid(id) & mask;
+    while (set->slots[s]) s = (s + 1) & mask;
+    set->slots[s] = copy;
+    set->count++;
+    return 1;
+}
+
+typedef struct {
+    ComponentColumns cols;
+    double *row;          // current student's marks, one per column
+    ModuleSums *sums;     // current student's per-module results
+    double *scratch;      // best-of group marks
+    char *sid;            // current student id
+    size_t sid_cap;
+    IdSet done;           // students already written
+    OutBuf *ob;
+} StreamState;
+
+static void stream_state_free(StreamState *st) {
+    free(st->ob);
+    free(st->done.slots);
+    arena_free(&st->done.ids);
+    columns_free(&st->cols);
+    free(st->row);
+    free(st->sums);
+    free(st->scratch);
+    free(st->sid);
+}
+
+static int stream_flush(StreamState *st, const ModuleList *schema, const Config *cfg) {
+    for (size_t i = 0; i < schema->count; i++)
+        cohort_eval_module(schema, &st->cols, i, st->row, st->scratch, &st->sums[i]);
+    cohort_write_student(st->ob, schema, st->sid, st->sums, cfg);
+
+    for (size_t j = 0; j < st->cols.count; j++) st->row[j] = -1.0;
+    return idset_add(&st->done, st->sid);
+}
+
+/*
+Same input and output as load_cohort_marks + cohort_report_csv, but the
+rows must be grouped by student: each student is evaluated and written
+as soon as the next one starts, and only one student's marks (plus the
+ids already written) are held. A student with no row naming a known
+component gets no record, as in the cohort report; a student whose rows
+resume after another student's is an error.
+*/
+int stream_cohort_report(ModuleList *schema, const char *path, const Config *cfg, FILE *out) {
+    StreamState st;
+    memset(&st, 0, sizeof st);
+    arena_init(&st.done.ids, 64 * 1024);
+
+    size_t max_group = 0;
+    if (!cohort_prepare_schema(schema, &max_group) || !columns_build(&st.cols, schema)) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+
+    size_t ncols = st.cols.count ? st.cols.count : 1;
+    st.row = malloc(ncols * sizeof(double));
+    st.sums = malloc((schema->count ? schema->count : 1) * sizeof(ModuleSums));
+    st.scratch = malloc((max_group ? max_group : 1) * sizeof(double));
+    st.ob = malloc(sizeof *st.ob);
+    if (!st.row || !st.sums || !st.scratch || !st.ob) {
+        fprintf(stderr, "Out of memory\n");
+        stream_state_free(&st);
+        return 0;
+    }
+    for (size_t j = 0; j < st.cols.count; j++) st.row[j] = -1.0;
+
+    CsvFile *cf = csv_open_mmap(path);
+    if (!cf) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        stream_state_free(&st);
+        return 0;
+    }
+
+    CsvRow row;
+    int rc = csv_read_row_view(cf, &row);
+    CohortColumns col;
+    if (rc <= 0 || !cohort_columns(&row, schema, path, &col)) {
+        if (rc <= 0) fprintf(stderr, "%s: missing header row\n", path);
+        csv_close(cf);
+        stream_state_free(&st);
+        return 0;
+    }
+
+    outbuf_init(st.ob, out);
+    cohort_write_header(st.ob);
+    int have_student = 0;
+
+    while ((rc = csv_read_row_view(cf, &row)) > 0) {
+        if (row.count <= col.need) continue;
+
+        long id = cohort_component(schema, &col, &row);
+        if (id < 0) continue;
+
+        const char *sid = row.fields[col.student];
+        if (!have_student || strcmp(sid, st.sid) != 0) {
+            if (have_student && !stream_flush(&st, schema, cfg)) { rc = -2; break; }
+            if (idset_has(&st.done, sid)) {
+                fprintf(stderr, "%s: rows for student %s resume after other students; "
+                        "--stream needs rows grouped by student (use --cohort)\n", path, sid);
+                rc = -3;
+                break;
+            }
+
+            size_t n = strlen(sid) + 1;
+            if (n > st.sid_cap) {
+                char *ns = realloc(st.sid, n);
+                if (!ns) { rc = -2; break; }
+                st.sid = ns;
+                st.sid_cap = n;
+            }
+            memcpy(st.sid, sid, n);
+            have_student = 1;
+        }
+
+        double mark = 0.0;
+        if (parse_double(row.fields[col.mark], &mark)) st.row[id] = mark;
+    }
+
+    if (rc == 0 && have_student && !stream_flush(&st, schema, cfg)) rc = -2;
+    if (rc == -1) fprintf(stderr, "CSV read error in %s\n", path);
+    if (rc == -2) fprintf(stderr, "Out of memory\n");
+    if (!outbuf_flush(st.ob)) {
+        fprintf(stderr, "Failed to write report\n");
+        if (rc == 0) rc = -4;
     }
 
     csv_close(cf);
-    return 1;
+    stream_state_free(&st);
+    return rc == 0;
 }
 
 /* -------------------- Save marks.csv -------------------- */
 
-int save_marks_csv(const ModuleList *modules, const char *path) {
-    FILE *fp = fopen(path, "w");
+static size_t format_int(char *buf, int v) {
+    return (size_t)snprintf(buf, 16, "%d", v);
+}
+
+// a name of up to 63 bytes, every one a doubled '"', plus its quotes
+#define MARK_LINE_MAX (16 + 2 * 64 + FIXED2_TEXT_MAX + 2)
+#define MARKS_HEADER "module_id,component_name,mark\n"
+
+// s as one CSV field, quoted the way outbuf_csv_field quotes report cells
+static size_t format_csv_field(char *buf, const char *s) {
+    size_t len = strlen(s);
+    if (!strpbrk(s, ",\"\r\n")) {
+        memcpy(buf, s, len);
+        return len;
+    }
+    len = 0;
+    buf[len++] = '"';
+    for (; *s; s++) {
+        if (*s == '"') buf[len++] = '"';
+        buf[len++] = *s;
+    }
+    buf[len++] = '"';
+    return len;
+}
+
+// One marks.csv line for c into buf (MARK_LINE_MAX bytes); returns the length.
+static size_t format_mark_line(char *buf, const Module *m, const Component *c) {
+    size_t len = format_int(buf, m->id);
+    buf[len++] = ',';
+    len += format_csv_field(buf + len, c->name);
+    buf[len++] = ',';
+    if (c->mark >= 0.0) len += format_fixed2(buf + len, c->mark);
+    buf[len++] = '\n';
+    return len;
+}
+
+// fsync the directory holding path so a rename into it is durable
+static void sync_parent_dir(const char *path) {
+    char dir[4096];
+    const char *slash = strrchr(path, '/');
+    if (slash) snprintf(dir, sizeof dir, "%.*s", (int)(slash - path), path);
+    else snprintf(dir, sizeof dir, ".");
+    if (dir[0] == '\0') snprintf(dir, sizeof dir, "/");
+
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) return;
+    (void)fsync(fd);
+    close(fd);
+}
+
+/*
+Writes the whole file to <path>.tmp through a 1 MiB buffer, fsyncs it and
+renames it over path, so a crash leaves either the old or the new file.
+The temporary takes the old file's permission bits first, so the rename
+does not reset them to the umask default. A successful save also folds
+in and removes the edit journal.
+*/
+static int write_marks_csv(const ModuleList *modules, const char *path) {
+    char tmp[4096];
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+
+    FILE *fp = fopen(tmp, "w");
     if (!fp) {
         fprintf(stderr, "Failed to write %s\n", path);
         return 0;
     }
+    struct stat st;
+    if (stat(path, &st) == 0) (void)fchmod(fileno(fp), st.st_mode & 07777);   // best effort
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
 
-    fprintf(fp, "module_id,component_name,mark\n");
+    fputs(MARKS_HEADER, fp);
+    STATS_ADD(STAT_BYTES_WRITTEN, sizeof MARKS_HEADER - 1);
 
+    char line[MARK_LINE_MAX];
     for (size_t i = 0; i < modules->count; i++) {
         const Module *m = &modules->items[i];
         for (size_t j = 0; j < m->component_count; j++) {
-            const Component *c = &m->components[j];
-            if (c->mark >= 0.0) {
-                fprintf(fp, "%d,%s,%.2f\n", m->id, c->name, c->mark);
-            } else {
-                fprintf(fp, "%d,%s,\n", m->id, c->name);
-            }
+            size_t n = format_mark_line(line, m, &m->components[j]);
+            fwrite(line, 1, n, fp);
+            STATS_ADD(STAT_BYTES_WRITTEN, n);
         }
     }
 
-    fclose(fp);
+    int ok = (fflush(fp) == 0) && (fsync(fileno(fp)) == 0);
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        remove(tmp);
+        return 0;
+    }
+    sync_parent_dir(path);
+
+    char jpath[4096];
+    journal_path(path, jpath, sizeof jpath);
+    remove(jpath);
     return 1;
 }
+
+int save_marks_csv(const ModuleList *modules, const char *path) {
+    STATS_PHASE_BEGIN(t0);
+    int ok = write_marks_csv(modules, path);
+    STATS_PHASE_END(STAT_PHASE_SAVE, t0);
+    return ok;
+}
+
+/* -------------------- Edit journal -------------------- */
+
+int journal_append_mark(const char *path, const Module *m, const Component *c) {
+    char jpath[4096];
+    journal_path(path, jpath, sizeof jpath);
+
+    FILE *fp = fopen(jpath, "a");
+    if (!fp) {
+        fprintf(stderr, "Failed to write %s\n", jpath);
+        return 0;
+    }
+
+    // header on a fresh journal so it parses like marks.csv
+    if (ftell(fp) == 0) {
+        fputs(MARKS_HEADER, fp);
+        STATS_ADD(STAT_BYTES_WRITTEN, sizeof MARKS_HEADER - 1);
+    }
+
+    char line[MARK_LINE_MAX];
+    size_t n = format_mark_line(line, m, c);
+    fwrite(line, 1, n, fp);
+    STATS_ADD(STAT_BYTES_WRITTEN, n);
+
+    int ok = (fflush(fp) == 0) && (fsync(fileno(fp)) == 0);
+    if (fclose(fp) != 0) ok = 0;
+    return ok;
+}
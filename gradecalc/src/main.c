@@ -1,34 +1,356 @@
+#include <errno.h>
+#include <float.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "grades.h"
 #include "config.h"
+#include "csv.h"
+#include "cohort.h"
 #include "io.h"
+#include "mc.h"
+#include "pool.h"
+#include "report.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "sweep.h"
 #include "ui.h"
 
-int main(void) {
-    ModuleList modules;
-    module_list_init(&modules);
+static const SnapshotSources DEFAULT_SOURCES = {
+    "data/modules.csv", "data/components.csv", "data/marks.csv"
+};
+#define SNAPSHOT_PATH "data/.gradecalc.snap"
+
+static int default_sources(const SnapshotSources *src) {
+    return snapshot_same_file(src->modules, DEFAULT_SOURCES.modules) &&
+           snapshot_same_file(src->components, DEFAULT_SOURCES.components) &&
+           snapshot_same_file(src->marks, DEFAULT_SOURCES.marks);
+}
+
+// Initializes modules and loads the data files, from the binary snapshot
+// while it is current.
+// Only the menu (save_snapshot) writes a fresh parse back: batch runs
+// leave data/ alone, and without marks (cohort mode) there is nothing
+// to snapshot. The snapshot only ever describes the default data/ files.
+static int load_dataset(ModuleList *modules, const SnapshotSources *src, int with_marks,
+                        int save_snapshot, unsigned nthreads) {
+    int use_snapshot = default_sources(src);
+
+    SnapshotStamp stamps[SNAPSHOT_SOURCES];
+    if (use_snapshot && snapshot_load(modules, SNAPSHOT_PATH, src, stamps)) return 1;
+
+    // All schema storage lives in one arena sized from the CSV line counts
+    size_t hint = module_list_arena_hint(csv_count_rows(src->modules),
+                                         csv_count_rows(src->components));
+    if (!module_list_init_arena(modules, hint)) module_list_init(modules);
+
+    if (!load_modules(modules, src->modules)) return 0;
+    if (!load_components(modules, src->components)) return 0;
+    if (!with_marks) return 1;
+    if (!load_marks(modules, src->marks, nthreads)) return 0;
+
+    // Best effort: a read-only data directory only costs the warm start
+    if (use_snapshot && save_snapshot) (void)snapshot_save(modules, SNAPSHOT_PATH, stamps);
+    return 1;
+}
+
+static int parse_number(const char *s, double *out) {
+    char *end = NULL;
+    double v = strtod(s, &end);
+    if (end == s || *end != '\0') return 0;
+    *out = v;
+    return 1;
+}
+
+// A mark from 0 to 100; nan and inf fail the range test too
+static int parse_percent(const char *s, double *out) {
+    double v;
+    if (!parse_number(s, &v) || !(v >= 0.0 && v <= 100.0)) return 0;
+    *out = v;
+    return 1;
+}
+
+// A finite spread, 0 or more
+static int parse_sd(const char *s, double *out) {
+    double v;
+    if (!parse_number(s, &v) || !(v >= 0.0 && v <= DBL_MAX)) return 0;
+    *out = v;
+    return 1;
+}
+
+// Digits only: strtoull would take "-1" as ULLONG_MAX
+static int parse_count(const char *s, unsigned long long *out) {
+    if (*s < '0' || *s > '9') return 0;
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(s, &end, 10);
+    if (*end != '\0' || errno == ERANGE) return 0;
+    *out = v;
+    return 1;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --batch                 print the report without prompts and exit\n"
+            "  --format csv|jsonl      batch output format (default csv; implies --batch)\n"
+            "  --target PCT            target mark (default 70)\n"
+            "  --assume-other PCT      assumed mark on other remaining work (default 70)\n"
+            "  --modules PATH          (default data/modules.csv)\n"
+            "  --components PATH       (default data/components.csv)\n"
+            "  --marks PATH            (default data/marks.csv; batch mode only)\n"
+            "  --sweep-target FROM:TO:STEP\n"
+            "  --sweep-assume FROM:TO:STEP\n"
+            "                          needed marks over a target x assume_other grid\n"
+            "  --monte-carlo N         distribution of the overall mark over N draws of the\n"
+            "                          unset marks (also per student with --cohort)\n"
+            "  --mc-sd SD              spread of a drawn mark (default 10)\n"
+            "  --mc-mean assume|student  centre of a drawn mark (default assume)\n"
+            "  --mc-priors PATH        per-component mean/sd overrides\n"
+            "  --mc-seed N             (default 1)\n"
+            "  --threads N             workers for large marks files, --cohort and\n"
+            "                          --monte-carlo (default: all CPUs)\n"
+            "  --cohort marks.csv [--group-needed]\n"
+            "  --stream marks.csv\n"
+            "  --component-ids         list component_id,module_id,component_name and exit\n",
+            argv0);
+}
+
+// What-if grid requested on the command line; an axis that was not
+// given stays fixed at the Config value
+typedef struct {
+    int enabled;
+    SweepAxis target;
+    SweepAxis assume;
+    ReportFormat format;
+} SweepOptions;
+
+// Monte Carlo run requested on the command line
+typedef struct {
+    int enabled;
+    McOptions opts;
+    const char *priors_path;
+} McRequest;
+
+// Loads the optional priors file; priors stay empty without one
+static int load_priors(McPriors *priors, ModuleList *modules, const McRequest *mc) {
+    if (!mc_priors_init(priors, modules)) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+    if (mc->priors_path && !load_mc_priors(priors, modules, mc->priors_path)) {
+        mc_priors_free(priors);
+        return 0;
+    }
+    return 1;
+}
+
+// gradecalc --cohort <marks.csv>: tabulate every student in the file
+static int run_cohort(ModuleList *modules, const Config *cfg, const char *path, unsigned nthreads,
+                      const SweepOptions *sweep, int group_needed, const McRequest *mc) {
+    Cohort cohort;
+    if (!cohort_init(&cohort, modules)) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    if (!load_cohort_marks(&cohort, path, nthreads)) {
+        cohort_free(&cohort);
+        return 1;
+    }
+
+    ModuleSums *sums = cohort_evaluate(&cohort, nthreads);
+    if (!sums) {
+        fprintf(stderr, "Out of memory\n");
+        cohort_free(&cohort);
+        return 1;
+    }
+
+    int rc = 0;
+    McPriors priors;
+    if (mc->enabled) {
+        if (!load_priors(&priors, modules, mc)) {
+            rc = 1;
+        } else {
+            rc = mc_cohort_report(&cohort, &priors, &mc->opts, cfg, nthreads,
+                                  sweep->format, stdout) ? 0 : 1;
+            mc_priors_free(&priors);
+        }
+    } else if (group_needed) {
+        rc = cohort_group_report_csv(&cohort, sums, cfg, stdout) ? 0 : 1;
+    } else if (sweep->enabled) {
+        rc = sweep_cohort_report(&cohort, sums, &sweep->target, &sweep->assume,
+                                 sweep->format, stdout) ? 0 : 1;
+    } else {
+        rc = cohort_report_csv(&cohort, sums, cfg, stdout) ? 0 : 1;
+    }
+    free(sums);
+    cohort_free(&cohort);
+    return rc;
+}
+
+int main(int argc, char **argv) {
+    STATS_DUMP_AT_EXIT();
 
+    SnapshotSources sources = DEFAULT_SOURCES;
     Config cfg = { .target = 70.0, .assume_other = 70.0 };
+    const char *cohort_path = NULL;
+    int stream = 0;
+    int batch = 0;
+    ReportFormat format = REPORT_CSV;
+    unsigned nthreads = pool_default_threads();
+    SweepOptions sweep = { 0 };
+    int sweep_target = 0, sweep_assume = 0;
+    int group_needed = 0;
+    int component_ids = 0;
+    McRequest mc = { 0, { 0, 1, 10.0, MC_MEAN_ASSUME }, NULL };
+    unsigned long long count;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc &&
+                   report_parse_format(argv[i + 1], &format)) {
+            batch = 1;
+            i++;
+        } else if (strcmp(argv[i], "--target") == 0 && i + 1 < argc &&
+                   parse_percent(argv[i + 1], &cfg.target)) {
+            i++;
+        } else if (strcmp(argv[i], "--assume-other") == 0 && i + 1 < argc &&
+                   parse_percent(argv[i + 1], &cfg.assume_other)) {
+            i++;
+        } else if (strcmp(argv[i], "--sweep-target") == 0 && i + 1 < argc &&
+                   sweep_parse_axis(argv[i + 1], &sweep.target)) {
+            sweep_target = 1;
+            i++;
+        } else if (strcmp(argv[i], "--sweep-assume") == 0 && i + 1 < argc &&
+                   sweep_parse_axis(argv[i + 1], &sweep.assume)) {
+            sweep_assume = 1;
+            i++;
+        } else if (strcmp(argv[i], "--monte-carlo") == 0 && i + 1 < argc &&
+                   parse_count(argv[i + 1], &count) && count > 0) {
+            mc.opts.samples = (size_t)count;
+            mc.enabled = 1;
+            i++;
+        } else if (strcmp(argv[i], "--mc-sd") == 0 && i + 1 < argc &&
+                   parse_sd(argv[i + 1], &mc.opts.sd)) {
+            i++;
+        } else if (strcmp(argv[i], "--mc-mean") == 0 && i + 1 < argc &&
+                   (strcmp(argv[i + 1], "assume") == 0 || strcmp(argv[i + 1], "student") == 0)) {
+            mc.opts.mean = strcmp(argv[++i], "student") == 0 ? MC_MEAN_STUDENT : MC_MEAN_ASSUME;
+        } else if (strcmp(argv[i], "--mc-priors") == 0 && i + 1 < argc) {
+            mc.priors_path = argv[++i];
+        } else if (strcmp(argv[i], "--mc-seed") == 0 && i + 1 < argc &&
+                   parse_count(argv[i + 1], &count)) {
+            mc.opts.seed = count;
+            i++;
+        } else if (strcmp(argv[i], "--group-needed") == 0) {
+            group_needed = 1;
+        } else if (strcmp(argv[i], "--component-ids") == 0) {
+            component_ids = 1;
+            batch = 1;
+        } else if (strcmp(argv[i], "--modules") == 0 && i + 1 < argc) {
+            sources.modules = argv[++i];
+        } else if (strcmp(argv[i], "--components") == 0 && i + 1 < argc) {
+            sources.components = argv[++i];
+        } else if (strcmp(argv[i], "--marks") == 0 && i + 1 < argc) {
+            sources.marks = argv[++i];
+        } else if (strcmp(argv[i], "--cohort") == 0 && i + 1 < argc) {
+            cohort_path = argv[++i];
+            stream = 0;
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            cohort_path = argv[++i];
+            stream = 1;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            nthreads = (unsigned)atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (sweep_target || sweep_assume) {
+        if (stream) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (!sweep_target) sweep_axis_fixed(&sweep.target, cfg.target);
+        if (!sweep_assume) sweep_axis_fixed(&sweep.assume, cfg.assume_other);
+        sweep.enabled = 1;
+        if (!cohort_path) batch = 1;
+    }
+
+    if (mc.enabled) {
+        if (stream) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (!cohort_path) batch = 1;
+    }
+    sweep.format = format;
+
+    if (group_needed && (!cohort_path || stream)) {
+        usage(argv[0]);
+        return 2;
+    }
 
-    if (!load_modules(&modules, "data/modules.csv")) {
+    // The menu saves and journals to data/marks.csv
+    if (!snapshot_same_file(sources.marks, DEFAULT_SOURCES.marks) && !batch && !cohort_path) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    ModuleList modules;
+    if (!load_dataset(&modules, &sources, cohort_path == NULL, !batch && !cohort_path, nthreads)) {
         module_list_free(&modules);
         return 1;
     }
-    if (!load_components(&modules, "data/components.csv")) {
+
+    if (component_ids) {
+        int rc = report_component_ids(&modules, format, stdout) ? 0 : 1;
+        module_list_free(&modules);
+        return rc;
+    }
+    if (cohort_path && stream) {
+        int rc = stream_cohort_report(&modules, cohort_path, &cfg, stdout) ? 0 : 1;
         module_list_free(&modules);
-        return 1;
+        return rc;
     }
-    if (!load_marks(&modules, "data/marks.csv")) {
+    if (cohort_path) {
+        int rc = run_cohort(&modules, &cfg, cohort_path, nthreads, &sweep, group_needed, &mc);
         module_list_free(&modules);
-        return 1;
+        return rc;
+    }
+
+    if (batch) {
+        int ok;
+        McPriors priors;
+        if (mc.enabled) {
+            ok = load_priors(&priors, &modules, &mc);
+            if (ok) {
+                ok = mc_report(&modules, &priors, &mc.opts, &cfg, nthreads, format, stdout);
+                mc_priors_free(&priors);
+            }
+        } else if (sweep.enabled) {
+            ok = sweep_report(&modules, &sweep.target, &sweep.assume, format, stdout);
+        } else {
+            ok = report_batch(&modules, &cfg, format, stdout);
+        }
+        int rc = ok ? 0 : 1;
+        module_list_free(&modules);
+        return rc;
     }
 
-    ui_run(&modules, &cfg);
+    int schema_current = ui_run(&modules, &cfg);
 
-    // Auto-save on exit
-    if (!save_marks_csv(&modules, "data/marks.csv")) {
+    // Auto-save on exit; the snapshot then matches the files again, unless
+    // the schema was changed under us
+    if (!save_marks_csv(&modules, sources.marks)) {
         fprintf(stderr, "Warning: could not save data/marks.csv\n");
+    } else if (schema_current) {
+        SnapshotStamp stamps[SNAPSHOT_SOURCES];
+        snapshot_stamp_sources(&sources, stamps);
+        (void)snapshot_save(&modules, SNAPSHOT_PATH, stamps);
     }
 
     module_list_free(&modules);
@@ -0,0 +1,612 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "grades.h"
+#include "calc.h"
+#include "cohort.h"
+#include "mc.h"
+#include "pool.h"
+#include "report.h"
+
+const double MC_PERCENTILE_RANKS[MC_PERCENTILES] = { 0.05, 0.25, 0.50, 0.75, 0.95 };
+
+// Samples per pool task and per vectorised block inside a task
+#define MC_CHUNK 4096
+#define MC_BLOCK 256
+
+// Histogram of the overall mark in 0.01 steps over [0, 100]
+#define MC_BINS 10001
+
+/* -------------------- Priors -------------------- */
+
+int mc_priors_init(McPriors *p, const ModuleList *modules) {
+    memset(p, 0, sizeof *p);
+    p->module_offset = malloc((modules->count + 1) * sizeof(size_t));
+    if (!p->module_offset) return 0;
+
+    size_t n = 0;
+    for (size_t i = 0; i < modules->count; i++) {
+        p->module_offset[i] = n;
+        n += modules->items[i].component_count;
+    }
+    p->module_offset[modules->count] = n;
+    p->count = n;
+
+    p->mean = malloc((n ? n : 1) * sizeof(double));
+    p->sd = malloc((n ? n : 1) * sizeof(double));
+    if (!p->mean || !p->sd) {
+        mc_priors_free(p);
+        return 0;
+    }
+    for (size_t j = 0; j < n; j++) p->mean[j] = p->sd[j] = NAN;
+    return 1;
+}
+
+void mc_priors_free(McPriors *p) {
+    free(p->module_offset);
+    free(p->mean);
+    free(p->sd);
+    memset(p, 0, sizeof *p);
+}
+
+/* -------------------- Counter-based generator -------------------- */
+
+// SplitMix64 finaliser: a bijective mix, so distinct counters give
+// independent-looking outputs with no state carried between draws.
+static inline uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in (0, 1) for (stream key, counter)
+static inline double uniform_at(uint64_t key, uint64_t ctr) {
+    uint64_t h = mix64(key + ctr * 0x9E3779B97F4A7C15ULL);
+    return ((double)(h >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+static inline uint64_t stream_key(uint64_t seed, uint64_t component) {
+    return mix64(seed ^ mix64(component + 1));
+}
+
+// Standard normals for samples b .. b + n (b even). Box-Muller turns one
+// counter pair into the normals of samples 2p and 2p + 1, so a sample's
+// value depends only on the key and its own index.
+static void fill_normals(uint64_t key, size_t b, size_t n, double *out) {
+    for (size_t s = 0; s < n; s += 2) {
+        uint64_t pair = (b + s) / 2;
+        double r = sqrt(-2.0 * log(uniform_at(key, pair * 2)));
+        double theta = 6.283185307179586 * uniform_at(key, pair * 2 + 1);
+        out[s] = r * cos(theta);
+        if (s + 1 < n) out[s + 1] = r * sin(theta);
+    }
+}
+
+/* -------------------- Model -------------------- */
+
+// One unset mark: drawn from Normal(mean, sd), clamped, times coef
+typedef struct {
+    uint64_t key;
+    double mean, sd;
+    double coef;
+} McVar;
+
+// A best-of group with unset members: its best k of the fixed marks
+// (sorted descending) and the drawn members, times coef per mark
+typedef struct {
+    double coef;
+    size_t k;
+    size_t fixed_start, fixed_count;
+    size_t var_start, var_count;
+} McGroup;
+
+typedef struct {
+    double base;              // overall mark from everything already fixed
+    McVar *plain;
+    size_t plain_count;
+    McGroup *groups;
+    size_t group_count;
+    McVar *gvars;
+    size_t gvar_count;
+    double *gfixed;
+    size_t gfixed_count;
+    size_t max_k, max_vars;   // largest group best_of / drawn members
+} McModel;
+
+static void model_free(McModel *md) {
+    free(md->plain);
+    free(md->groups);
+    free(md->gvars);
+    free(md->gfixed);
+}
+
+// Credit-weighted average on marked work, as print_overall_summary shows
+// it, into *out; 0 if a module's sums ran out of memory
+static int student_average(const ModuleList *modules, const double *marks,
+                           const size_t *module_offset, double fallback, double *out) {
+    OverallSums o;
+    overall_init(&o);
+    for (size_t i = 0; i < modules->count; i++) {
+        const Module *m = &modules->items[i];
+        double S, W, R;
+        if (!module_sums_bestof_marks(m, marks ? marks + module_offset[i] : NULL, &S, &W, &R))
+            return 0;
+        overall_add(&o, m->credits, S, W, R);
+    }
+    *out = o.credit_W > 0.0 ? o.credit_S / o.credit_W : fallback;
+    return 1;
+}
+
+// Room for every component of the schema, so the same model can be
+// refilled for one student after another
+static int model_alloc(McModel *md, const ModuleList *modules) {
+    memset(md, 0, sizeof *md);
+
+    size_t ncomp = 0;
+    for (size_t i = 0; i < modules->count; i++) ncomp += modules->items[i].component_count;
+
+    md->plain = malloc((ncomp ? ncomp : 1) * sizeof(McVar));
+    md->gvars = malloc((ncomp ? ncomp : 1) * sizeof(McVar));
+    md->gfixed = malloc((ncomp ? ncomp : 1) * sizeof(double));
+    md->groups = malloc((ncomp ? ncomp : 1) * sizeof(McGroup));
+    return md->plain && md->gvars && md->gfixed && md->groups;
+}
+
+static int model_fill(McModel *md, const ModuleList *modules, const double *marks,
+                      const size_t *module_offset, const McPriors *priors,
+                      const McOptions *opts, const Config *cfg) {
+    md->base = 0.0;
+    md->plain_count = md->group_count = md->gvar_count = md->gfixed_count = 0;
+    md->max_k = md->max_vars = 0;
+
+    double total_credits = 0.0;
+    for (size_t i = 0; i < modules->count; i++) total_credits += modules->items[i].credits;
+
+    double default_mean = cfg->assume_other;
+    if (opts->mean == MC_MEAN_STUDENT &&
+        !student_average(modules, marks, module_offset, cfg->assume_other, &default_mean))
+        return 0;
+
+    // Overall = Σ credits * S / 100 / total_credits, S = Σ weight * mark
+    const double scale = total_credits > 0.0 ? 1.0 / (100.0 * total_credits) : 0.0;
+
+    // Each component's stream is keyed by its position in the schema, so
+    // a mark draws the same numbers whichever other marks are set
+    uint64_t first = 0;
+
+    for (size_t i = 0; i < modules->count; i++) {
+        const Module *m = &modules->items[i];
+        const double module_scale = m->credits * scale;
+        const double *mmarks = marks ? marks + module_offset[i] : NULL;
+        const uint64_t start = first;
+
+        for (size_t j = 0; j < m->component_count; j++) {
+            const Component *c = &m->components[j];
+            if (c->group_id != 0 && c->best_of != 0) continue;
+
+            double mk = mmarks ? mmarks[j] : c->mark;
+            if (mk >= 0.0) {
+                md->base += module_scale * c->weight * mk;
+                continue;
+            }
+            if (c->weight == 0.0) continue;
+
+            size_t pj = priors ? priors->module_offset[i] + j : 0;
+            double mean = (priors && !isnan(priors->mean[pj])) ? priors->mean[pj] : default_mean;
+            double sd = (priors && !isnan(priors->sd[pj])) ? priors->sd[pj] : opts->sd;
+            md->plain[md->plain_count++] = (McVar){
+                stream_key(opts->seed, start + j), mean, sd, module_scale * c->weight
+            };
+        }
+
+        first += m->component_count;
+
+        for (size_t g = 0; g < m->group_count; g++) {
+            const ComponentGroup *grp = &m->groups[g];
+            if (grp->item_weight < 0.0 || grp->best_of <= 0) continue;
+
+            const size_t *members = m->group_members + grp->member_start;
+            McGroup mg = { module_scale * grp->item_weight, (size_t)grp->best_of,
+                           md->gfixed_count, 0, md->gvar_count, 0 };
+
+            for (size_t t = 0; t < grp->member_count; t++) {
+                size_t j = members[t];
+                double mk = mmarks ? mmarks[j] : m->components[j].mark;
+                if (mk >= 0.0) {
+                    md->gfixed[md->gfixed_count + mg.fixed_count++] = mk;
+                    continue;
+                }
+
+                size_t pj = priors ? priors->module_offset[i] + j : 0;
+                double mean = (priors && !isnan(priors->mean[pj])) ? priors->mean[pj] : default_mean;
+                double sd = (priors && !isnan(priors->sd[pj])) ? priors->sd[pj] : opts->sd;
+                md->gvars[md->gvar_count + mg.var_count++] = (McVar){
+                    stream_key(opts->seed, start + j), mean, sd, 0.0
+                };
+            }
+
+            size_t keep = mg.k < mg.fixed_count ? mg.k : mg.fixed_count;
+            top_k_desc(md->gfixed + mg.fixed_start, mg.fixed_count, keep);
+            mg.fixed_count = keep;
+
+            if (mg.var_count == 0) {
+                // Nothing to draw: the group is as fixed as a plain mark
+                for (size_t t = 0; t < keep; t++)
+                    md->base += mg.coef * md->gfixed[mg.fixed_start + t];
+                continue;
+            }
+
+            md->gfixed_count += keep;
+            md->gvar_count += mg.var_count;
+            if (mg.k > md->max_k) md->max_k = mg.k;
+            if (mg.var_count > md->max_vars) md->max_vars = mg.var_count;
+            md->groups[md->group_count++] = mg;
+        }
+    }
+    return 1;
+}
+
+/* -------------------- Evaluation -------------------- */
+
+typedef struct {
+    const McModel *md;
+    double target;
+    size_t *hist;          // MC_BINS per worker
+    size_t *reached;       // per worker
+    double *chunk_sum;     // per MC_CHUNK, summed in order afterwards
+    double *scratch;       // scratch_stride per worker: group draws, then best-k
+    size_t scratch_stride;
+} McJob;
+
+static inline double clamp_mark(double x) {
+    return x < 0.0 ? 0.0 : (x > 100.0 ? 100.0 : x);
+}
+
+// Adds x to the descending best-k list top[0..*have)
+static inline void keep_best(double *top, size_t *have, size_t k, double x) {
+    size_t j;
+    if (*have < k) j = (*have)++;
+    else if (x > top[k - 1]) j = k - 1;
+    else return;
+    while (j > 0 && top[j - 1] < x) { top[j] = top[j - 1]; j--; }
+    top[j] = x;
+}
+
+static void mc_range(void *ctx, size_t begin, size_t end, unsigned worker) {
+    McJob *job = ctx;
+    const McModel *md = job->md;
+    size_t *hist = job->hist + (size_t)worker * MC_BINS;
+
+    double acc[MC_BLOCK];
+    double draw[MC_BLOCK];
+    double *gdraw = job->scratch + (size_t)worker * job->scratch_stride;
+    double *top = gdraw + md->max_vars * MC_BLOCK;
+
+    size_t reached = 0;
+    double sum = 0.0;
+
+    // The pool may hand over several chunks at once; sums stay per chunk
+    for (size_t b = begin; b < end; b += MC_BLOCK) {
+        if (b % MC_CHUNK == 0 && b != begin) {
+            job->chunk_sum[b / MC_CHUNK - 1] = sum;
+            sum = 0.0;
+        }
+
+        const size_t n = (end - b < MC_BLOCK) ? end - b : MC_BLOCK;
+
+        for (size_t s = 0; s < n; s++) acc[s] = md->base;
+
+        // Plain components: one pass per variable over the whole block
+        for (size_t v = 0; v < md->plain_count; v++) {
+            const McVar *var = &md->plain[v];
+            fill_normals(var->key, b, n, draw);
+            for (size_t s = 0; s < n; s++)
+                acc[s] += var->coef * clamp_mark(var->mean + var->sd * draw[s]);
+        }
+
+        // Best-of groups: draw the block for every member, then merge each
+        // sample's draws into the fixed best-k
+        for (size_t g = 0; g < md->group_count; g++) {
+            const McGroup *grp = &md->groups[g];
+            for (size_t v = 0; v < grp->var_count; v++) {
+                const McVar *var = &md->gvars[grp->var_start + v];
+                double *d = gdraw + v * MC_BLOCK;
+                fill_normals(var->key, b, n, d);
+                for (size_t s = 0; s < n; s++) d[s] = clamp_mark(var->mean + var->sd * d[s]);
+            }
+
+            const double *fixed = md->gfixed + grp->fixed_start;
+            for (size_t s = 0; s < n; s++) {
+                size_t have = grp->fixed_count;
+                memcpy(top, fixed, have * sizeof(double));
+                for (size_t v = 0; v < grp->var_count; v++)
+                    keep_best(top, &have, grp->k, gdraw[v * MC_BLOCK + s]);
+
+                double best = 0.0;
+                for (size_t t = 0; t < have; t++) best += top[t];
+                acc[s] += grp->coef * best;
+            }
+        }
+
+        for (size_t s = 0; s < n; s++) {
+            double x = acc[s];
+            long bin = (long)(x * 100.0 + 0.5);
+            if (bin < 0) bin = 0;
+            if (bin >= MC_BINS) bin = MC_BINS - 1;
+            hist[bin]++;
+            reached += (x >= job->target);
+            sum += x;
+        }
+    }
+
+    job->reached[worker] += reached;
+    if (end > begin) job->chunk_sum[(end - 1) / MC_CHUNK] = sum;
+}
+
+// Group draws and best-k of the largest group fit in this per worker
+static size_t scratch_stride(size_t max_group) {
+    return max_group * (MC_BLOCK + 1);
+}
+
+// Figures from one run's histogram (all workers folded into hist[0..MC_BINS))
+static void mc_summarise(const size_t *hist, size_t reached, const double *chunk_sum,
+                         size_t samples, McResult *out) {
+    // Integer counts and an in-order chunk sum keep every figure
+    // independent of the thread count
+    const size_t chunks = (samples + MC_CHUNK - 1) / MC_CHUNK;
+    double sum = 0.0;
+    for (size_t c = 0; c < chunks; c++) sum += chunk_sum[c];
+
+    out->samples = samples;
+    out->p_target = samples ? (double)reached / (double)samples : 0.0;
+    out->mean = samples ? sum / (double)samples : NAN;
+
+    size_t seen = 0, k = 0;
+    for (int p = 0; p < MC_PERCENTILES; p++) {
+        size_t rank = (size_t)ceil(MC_PERCENTILE_RANKS[p] * (double)samples);
+        if (rank == 0) rank = 1;
+        while (k < MC_BINS && seen + hist[k] < rank) seen += hist[k++];
+        out->percentile[p] = samples ? (double)(k < MC_BINS ? k : MC_BINS - 1) / 100.0 : NAN;
+    }
+}
+
+int mc_run(ModuleList *modules, const double *marks, const size_t *module_offset,
+           const McPriors *priors, const McOptions *opts, const Config *cfg,
+           unsigned nthreads, McResult *out) {
+    memset(out, 0, sizeof *out);
+    if (nthreads == 0) nthreads = 1;
+
+    size_t max_group = 0;
+    if (!cohort_prepare_schema(modules, &max_group)) return 0;
+
+    McModel md;
+    if (!model_alloc(&md, modules) ||
+        !model_fill(&md, modules, marks, module_offset, priors, opts, cfg)) {
+        model_free(&md);
+        return 0;
+    }
+
+    const size_t samples = opts->samples;
+    const size_t chunks = (samples + MC_CHUNK - 1) / MC_CHUNK;
+
+    McJob job = { &md, cfg->target, NULL, NULL, NULL, NULL, scratch_stride(max_group) };
+    job.hist = calloc((size_t)nthreads * MC_BINS, sizeof(size_t));
+    job.reached = calloc(nthreads, sizeof(size_t));
+    job.chunk_sum = calloc(chunks ? chunks : 1, sizeof(double));
+    job.scratch = malloc(((size_t)nthreads * job.scratch_stride + 1) * sizeof(double));
+
+    int ok = job.hist && job.reached && job.chunk_sum && job.scratch &&
+             pool_parallel_for(nthreads, samples, MC_CHUNK, mc_range, &job);
+
+    if (ok) {
+        size_t reached = 0;
+        for (unsigned w = 0; w < nthreads; w++) reached += job.reached[w];
+        for (unsigned w = 1; w < nthreads; w++)
+            for (size_t k = 0; k < MC_BINS; k++) job.hist[k] += job.hist[(size_t)w * MC_BINS + k];
+        mc_summarise(job.hist, reached, job.chunk_sum, samples, out);
+    }
+
+    free(job.hist);
+    free(job.reached);
+    free(job.chunk_sum);
+    free(job.scratch);
+    model_free(&md);
+    return ok;
+}
+
+// A cohort worker's own model and run buffers, refilled per student
+typedef struct {
+    McModel md;
+    McJob job;
+    size_t reached;
+} McWorker;
+
+typedef struct {
+    const Cohort *cohort;
+    const McPriors *priors;
+    const McOptions *opts;
+    const Config *cfg;
+    McWorker *workers;
+    McResult *results;     // per student
+    int failed;
+} McCohortJob;
+
+static void mc_students(void *ctx, size_t begin, size_t end, unsigned worker) {
+    McCohortJob *cj = ctx;
+    const Cohort *c = cj->cohort;
+    McWorker *w = &cj->workers[worker];
+    const size_t samples = cj->opts->samples;
+
+    for (size_t s = begin; s < end; s++) {
+        if (!model_fill(&w->md, c->schema, cohort_row(c, s), c->module_offset, cj->priors,
+                        cj->opts, cj->cfg)) {
+            cj->failed = 1;   // results[s..end) left unset
+            return;
+        }
+        memset(w->job.hist, 0, MC_BINS * sizeof(size_t));
+        w->job.reached[0] = 0;
+
+        // The same blocks and chunk sums as mc_run on any thread count
+        mc_range(&w->job, 0, samples, 0);
+        mc_summarise(w->job.hist, w->job.reached[0], w->job.chunk_sum, samples, &cj->results[s]);
+    }
+}
+
+static void cohort_workers_free(McWorker *workers, unsigned n) {
+    for (unsigned w = 0; w < n; w++) {
+        model_free(&workers[w].md);
+        free(workers[w].job.hist);
+        free(workers[w].job.reached);
+        free(workers[w].job.chunk_sum);
+        free(workers[w].job.scratch);
+    }
+    free(workers);
+}
+
+// Every student's figures, students spread over the workers (each
+// student's samples on one of them). Results match mc_run's.
+static McResult *mc_cohort_run(const Cohort *c, const McPriors *priors, const McOptions *opts,
+                               const Config *cfg, unsigned nthreads) {
+    if (nthreads == 0) nthreads = 1;
+
+    size_t max_group = 0;
+    if (!cohort_prepare_schema(c->schema, &max_group)) return NULL;
+
+    const size_t chunks = (opts->samples + MC_CHUNK - 1) / MC_CHUNK;
+    McResult *results = malloc((c->student_count ? c->student_count : 1) * sizeof(McResult));
+    McWorker *workers = calloc(nthreads, sizeof(McWorker));
+    int ok = results && workers;
+
+    for (unsigned i = 0; ok && i < nthreads; i++) {
+        McWorker *w = &workers[i];
+        McJob *job = &w->job;
+        job->md = &w->md;
+        job->target = cfg->target;
+        job->scratch_stride = scratch_stride(max_group);
+        job->hist = malloc(MC_BINS * sizeof(size_t));
+        job->reached = malloc(sizeof(size_t));
+        job->chunk_sum = malloc((chunks ? chunks : 1) * sizeof(double));
+        job->scratch = malloc((job->scratch_stride + 1) * sizeof(double));
+        ok = model_alloc(&w->md, c->schema) &&
+             job->hist && job->reached && job->chunk_sum && job->scratch;
+    }
+
+    McCohortJob cj = { c, priors, opts, cfg, workers, results, 0 };
+    ok = ok && pool_parallel_for(nthreads, c->student_count, 1, mc_students, &cj) && !cj.failed;
+
+    if (workers) cohort_workers_free(workers, nthreads);
+    if (!ok) {
+        free(results);
+        return NULL;
+    }
+    return results;
+}
+
+/* -------------------- Output -------------------- */
+
+static void write_header(OutBuf *ob, ReportFormat fmt, int with_student) {
+    if (fmt != REPORT_CSV) return;
+    if (with_student) outbuf_str(ob, "student_id,");
+    outbuf_str(ob, "samples,target,reach_target_pct,mean,p5,p25,p50,p75,p95\n");
+}
+
+static void write_result(OutBuf *ob, ReportFormat fmt, const char *sid, const Config *cfg,
+                         const McResult *r) {
+    static const char *const keys[MC_PERCENTILES] = { "p5", "p25", "p50", "p75", "p95" };
+
+    if (fmt == REPORT_CSV) {
+        if (sid) {
+            outbuf_csv_field(ob, sid);
+            outbuf_char(ob, ',');
+        }
+        outbuf_int(ob, (long)r->samples);
+        outbuf_char(ob, ',');
+        outbuf_num(ob, cfg->target);
+        outbuf_char(ob, ',');
+        outbuf_num(ob, r->p_target * 100.0);
+        outbuf_char(ob, ',');
+        outbuf_num(ob, r->mean);
+        for (int p = 0; p < MC_PERCENTILES; p++) {
+            outbuf_char(ob, ',');
+            outbuf_num(ob, r->percentile[p]);
+        }
+        outbuf_char(ob, '\n');
+        return;
+    }
+
+    outbuf_char(ob, '{');
+    if (sid) {
+        outbuf_str(ob, "\"student_id\":");
+        outbuf_json_string(ob, sid);
+        outbuf_char(ob, ',');
+    }
+    outbuf_str(ob, "\"samples\":");
+    outbuf_int(ob, (long)r->samples);
+    outbuf_str(ob, ",\"target\":");
+    outbuf_num(ob, cfg->target);
+    outbuf_str(ob, ",\"reach_target_pct\":");
+    outbuf_num(ob, r->p_target * 100.0);
+    outbuf_str(ob, ",\"mean\":");
+    outbuf_num(ob, r->mean);
+    for (int p = 0; p < MC_PERCENTILES; p++) {
+        outbuf_str(ob, ",\"");
+        outbuf_str(ob, keys[p]);
+        outbuf_str(ob, "\":");
+        outbuf_num(ob, r->percentile[p]);
+    }
+    outbuf_str(ob, "}\n");
+}
+
+int mc_report(ModuleList *modules, const McPriors *priors, const McOptions *opts,
+              const Config *cfg, unsigned nthreads, ReportFormat fmt, FILE *out) {
+    McResult r;
+    if (!mc_run(modules, NULL, NULL, priors, opts, cfg, nthreads, &r)) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+
+    OutBuf *ob = malloc(sizeof *ob);
+    if (!ob) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+    outbuf_init(ob, out);
+    write_header(ob, fmt, 0);
+    write_result(ob, fmt, NULL, cfg, &r);
+
+    int ok = outbuf_flush(ob);
+    if (!ok) fprintf(stderr, "Failed to write report\n");
+    free(ob);
+    return ok;
+}
+
+int mc_cohort_report(const Cohort *c, const McPriors *priors, const McOptions *opts,
+                     const Config *cfg, unsigned nthreads, ReportFormat fmt, FILE *out) {
+    OutBuf *ob = malloc(sizeof *ob);
+    if (!ob) {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+    outbuf_init(ob, out);
+    write_header(ob, fmt, 1);
+
+    McResult *results = mc_cohort_run(c, priors, opts, cfg, nthreads);
+    int ok = results != NULL;
+    if (ok) {
+        for (size_t s = 0; s < c->student_count; s++)
+            write_result(ob, fmt, c->student_ids[s], cfg, &results[s]);
+    } else {
+        fprintf(stderr, "Out of memory\n");
+    }
+    free(results);
+
+    if (!outbuf_flush(ob)) {
+        fprintf(stderr, "Failed to write report\n");
+        ok = 0;
+    }
+    free(ob);
+    return ok;
+}
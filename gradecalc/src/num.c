@@ -0,0 +1,106 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "num.h"
+
+// Ordinary magnitudes take an integer path; values near a rounding tie,
+// zeros and large values go through snprintf.
+size_t format_fixed2(char *buf, double v) {
+    size_t len = 0;
+    double mag = v;
+    if (v < 0.0) {
+        buf[len++] = '-';
+        mag = -v;
+    }
+
+    if (mag > 0.0 && mag < 1e6) {
+        double scaled = mag * 100.0;
+        unsigned long long whole = (unsigned long long)scaled;
+        double frac = scaled - (double)whole;
+        double off = frac - 0.5;
+        if (off > 1e-6 || off < -1e-6) {
+            unsigned long long cents = whole + (frac > 0.5);
+            char tmp[24];
+            size_t n = 0;
+            unsigned long long units = cents / 100;
+            do { tmp[n++] = (char)('0' + units % 10); units /= 10; } while (units);
+
+            while (n) buf[len++] = tmp[--n];
+            buf[len++] = '.';
+            buf[len++] = (char)('0' + (cents / 10) % 10);
+            buf[len++] = (char)('0' + cents % 10);
+            buf[len] = '\0';
+            return len;
+        }
+    }
+    return (size_t)snprintf(buf, FIXED2_TEXT_MAX, "%.2f", v);
+}
+
+int parse_int(const char *s, int *out) {
+    if (!s || !*s) return 0;
+
+    // up to 9 digits cannot overflow an int
+    const char *p = s;
+    int neg = (*p == '-');
+    if (*p == '-' || *p == '+') p++;
+    int v = 0, digits = 0;
+    while (digits < 9 && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+        digits++;
+    }
+    if (digits > 0 && *p == '\0') {
+        *out = neg ? -v : v;
+        return 1;
+    }
+
+    char *end = NULL;
+    long lv = strtol(s, &end, 10);
+    if (*end != '\0') return 0;
+    *out = (int)lv;
+    return 1;
+}
+
+static const double POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+int parse_double(const char *s, double *out) {
+    if (!s || !*s) return 0;
+
+    // [+-]digits[.digits] with at most 19 digits: when the digits fit in
+    // 53 bits and the power of ten is exact (10^22 at most), one division
+    // is the correctly rounded result, as strtod would give.
+    const char *p = s;
+    int neg = (*p == '-');
+    if (*p == '-' || *p == '+') p++;
+    uint64_t mant = 0;
+    int digits = 0, frac = 0;
+    while (*p >= '0' && *p <= '9') {
+        if (digits < 19) mant = mant * 10 + (uint64_t)(*p - '0');
+        digits++;
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') {
+            if (digits < 19) mant = mant * 10 + (uint64_t)(*p - '0');
+            digits++;
+            frac++;
+            p++;
+        }
+    }
+    if (*p == '\0' && digits > 0 && digits <= 19 && frac <= 22 && mant <= (UINT64_C(1) << 53)) {
+        double v = (double)mant / POW10[frac];
+        *out = neg ? -v : v;
+        return 1;
+    }
+
+    // exponents, inf/nan, hex, long digit strings, blanks and junk
+    char *end = NULL;
+    double v = strtod(s, &end);
+    if (*end != '\0') return 0;
+    *out = v;
+    return 1;
+}
@@ -0,0 +1,368 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "csv.h"
+#include "num.h"
+#include "pipeline.h"
+
+/* -------------------- SPSC ring -------------------- */
+
+// Holds every block plus the end-of-stream NULL, so a push never waits;
+// backpressure comes from the fixed number of blocks instead.
+#define RING_SLOTS 16
+
+// Empty polls before a consumer goes to sleep on the ring's condvar
+#define RING_SPIN 64
+
+typedef struct {
+    _Alignas(64) atomic_size_t head;   // next slot to pop, written by the consumer
+    _Alignas(64) atomic_size_t tail;   // next slot to fill, written by the producer
+    void *slot[RING_SLOTS];
+
+    // Parking for a consumer that found the ring empty; the producer only
+    // takes the lock when sleeping says someone may be waiting
+    atomic_int sleeping;
+    pthread_mutex_t lock;
+    pthread_cond_t nonempty;
+} SpscRing;
+
+static void ring_init(SpscRing *r) {
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->sleeping, 0);
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->nonempty, NULL);
+}
+
+static void ring_destroy(SpscRing *r) {
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->nonempty);
+}
+
+static void ring_push(SpscRing *r, void *item) {
+    size_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    r->slot[t % RING_SLOTS] = item;
+    atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+
+    // Pairs with the fence in ring_pop: either the consumer sees the new
+    // tail before it sleeps, or we see it sleeping and wake it
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&r->sleeping, memory_order_relaxed)) {
+        pthread_mutex_lock(&r->lock);
+        pthread_cond_signal(&r->nonempty);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+static int ring_try_pop(SpscRing *r, void **item) {
+    size_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (atomic_load_explicit(&r->tail, memory_order_acquire) == h) return 0;
+    *item = r->slot[h % RING_SLOTS];
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+    return 1;
+}
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+// Pops the next item: a short spin for a producer that is nearly done,
+// then sleeps until the next push. The wait is added to *wait_ns.
+static void *ring_pop(SpscRing *r, unsigned long long *wait_ns) {
+    void *item;
+    if (ring_try_pop(r, &item)) return item;
+
+    unsigned long long t0 = now_ns();
+    for (int spin = 0; spin < RING_SPIN; spin++) {
+        if (ring_try_pop(r, &item)) {
+            *wait_ns += now_ns() - t0;
+            return item;
+        }
+        sched_yield();
+    }
+
+    pthread_mutex_lock(&r->lock);
+    atomic_store_explicit(&r->sleeping, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!ring_try_pop(r, &item)) pthread_cond_wait(&r->nonempty, &r->lock);
+    atomic_store_explicit(&r->sleeping, 0, memory_order_relaxed);
+    pthread_mutex_unlock(&r->lock);
+
+    *wait_ns += now_ns() - t0;
+    return item;
+}
+
+/* -------------------- Blocks -------------------- */
+
+typedef struct {
+    int module_id;
+    int clear;          // unset the mark instead of applying mark
+    double mark;
+    size_t name;        // offset into the block's names
+} PipeRow;
+
+typedef struct {
+    char *data;         // whole lines from the reader
+    size_t len, cap;
+
+    PipeRow *rows;      // tokenizer output
+    size_t count, row_cap;
+    char *names;        // NUL-terminated component names
+    size_t names_len, names_cap;
+} PipeBlock;
+
+static void block_free(PipeBlock *b) {
+    free(b->data);
+    free(b->rows);
+    free(b->names);
+}
+
+typedef struct {
+    ModuleList *modules;
+    FILE *in;
+    int clear_on_empty;
+
+    PipeBlock blocks[PIPELINE_BLOCKS];
+    SpscRing free_blocks;   // resolver -> reader
+    SpscRing read_blocks;   // reader -> tokenizer
+    SpscRing rows_blocks;   // tokenizer -> resolver
+
+    atomic_int failed;
+    PipelineStats stats;
+} Pipeline;
+
+/* -------------------- Stages -------------------- */
+
+static void *read_stage(void *arg) {
+    Pipeline *p = arg;
+    PipelineStageStats *st = &p->stats.stage[PIPELINE_READ];
+    char *carry = NULL;         // partial last line of the previous block
+    size_t carry_len = 0, carry_cap = 0;
+
+    while (!atomic_load(&p->failed)) {
+        PipeBlock *b = ring_pop(&p->free_blocks, &st->wait_out_ns);
+        unsigned long long t0 = now_ns();
+
+        // a carried line can be longer than this block if another one grew
+        if (carry_len >= b->cap) {
+            char *nd = realloc(b->data, carry_len * 2);
+            if (!nd) {
+                atomic_store(&p->failed, 1);
+                ring_push(&p->read_blocks, b);
+                break;
+            }
+            b->data = nd;
+            b->cap = carry_len * 2;
+        }
+        if (carry_len) memcpy(b->data, carry, carry_len);
+        b->len = carry_len;
+
+        // Fill the block; a line longer than the block grows it
+        int eof = 0;
+        size_t cut = 0;
+        while (!eof) {
+            size_t got = fread(b->data + b->len, 1, b->cap - b->len, p->in);
+            if (got == 0) {
+                if (ferror(p->in)) atomic_store(&p->failed, 1);
+                eof = 1;
+                break;
+            }
+            st->items += got;
+            b->len += got;
+
+            const char *nl = NULL;
+            for (size_t i = b->len; i > 0; i--)
+                if (b->data[i - 1] == '\n') { nl = b->data + i - 1; break; }
+            if (nl) {
+                cut = (size_t)(nl - b->data) + 1;
+                break;
+            }
+            if (b->len == b->cap) {
+                char *nd = realloc(b->data, b->cap * 2);
+                if (!nd) { atomic_store(&p->failed, 1); eof = 1; break; }
+                b->data = nd;
+                b->cap *= 2;
+            }
+        }
+        if (eof) cut = b->len;
+
+        carry_len = b->len - cut;
+        if (carry_len > carry_cap) {
+            char *nc = realloc(carry, carry_len);
+            if (!nc) { atomic_store(&p->failed, 1); carry_len = 0; }
+            else { carry = nc; carry_cap = carry_len; }
+        }
+        if (carry_len) memcpy(carry, b->data + cut, carry_len);
+        b->len = cut;
+
+        st->busy_ns += now_ns() - t0;
+        ring_push(&p->read_blocks, b);
+        if (eof) break;
+    }
+
+    free(carry);
+    ring_push(&p->read_blocks, NULL);
+    return NULL;
+}
+
+static int push_row(PipeBlock *b, const PipeRow *row, const char *name) {
+    if (b->count == b->row_cap) {
+        size_t cap = b->row_cap ? b->row_cap * 2 : 1024;
+        PipeRow *nr = realloc(b->rows, cap * sizeof *nr);
+        if (!nr) return 0;
+        b->rows = nr;
+        b->row_cap = cap;
+    }
+    size_t n = strlen(name) + 1;
+    if (b->names_len + n > b->names_cap) {
+        size_t cap = b->names_cap ? b->names_cap * 2 : 16 * 1024;
+        while (cap < b->names_len + n) cap *= 2;
+        char *nn = realloc(b->names, cap);
+        if (!nn) return 0;
+        b->names = nn;
+        b->names_cap = cap;
+    }
+
+    b->rows[b->count] = *row;
+    b->rows[b->count++].name = b->names_len;
+    memcpy(b->names + b->names_len, name, n);
+    b->names_len += n;
+    return 1;
+}
+
+// Same row rules as load_marks, minus the lookups left to the resolver
+static int tokenize_block(Pipeline *p, PipeBlock *b) {
+    b->count = 0;
+    b->names_len = 0;
+
+    CsvFile *f = csv_open_memory(b->data, b->len);
+    if (!f) return 0;
+
+    CsvRow row;
+    int rc;
+    while ((rc = csv_read_row_view(f, &row)) > 0) {
+        if (row.count < 3) continue;
+
+        PipeRow r = { 0, 0, 0.0, 0 };
+        if (!parse_int(row.fields[0], &r.module_id)) continue;
+        if (!parse_double(row.fields[2], &r.mark)) {
+            if (!p->clear_on_empty || row.fields[2][0] != '\0') continue;
+            r.clear = 1;
+        }
+        if (!push_row(b, &r, row.fields[1])) { rc = -1; break; }
+    }
+    csv_close(f);
+    return rc == 0;
+}
+
+static void *tokenize_stage(void *arg) {
+    Pipeline *p = arg;
+    PipelineStageStats *st = &p->stats.stage[PIPELINE_TOKENIZE];
+
+    PipeBlock *b;
+    while ((b = ring_pop(&p->read_blocks, &st->wait_in_ns)) != NULL) {
+        unsigned long long t0 = now_ns();
+        // after a failure blocks still pass through so the reader can finish
+        if (!atomic_load(&p->failed) && !tokenize_block(p, b)) atomic_store(&p->failed, 1);
+        if (atomic_load(&p->failed)) b->count = 0;
+        st->items += b->count;
+        st->busy_ns += now_ns() - t0;
+        ring_push(&p->rows_blocks, b);
+    }
+    ring_push(&p->rows_blocks, NULL);
+    return NULL;
+}
+
+static void resolve_stage(Pipeline *p) {
+    PipelineStageStats *st = &p->stats.stage[PIPELINE_RESOLVE];
+
+    PipeBlock *b;
+    while ((b = ring_pop(&p->rows_blocks, &st->wait_in_ns)) != NULL) {
+        unsigned long long t0 = now_ns();
+        for (size_t i = 0; i < b->count; i++) {
+            const PipeRow *r = &b->rows[i];
+            long id = module_list_component_id(p->modules, r->module_id, b->names + r->name);
+            if (id < 0) continue;
+            module_list_component(p->modules, (size_t)id, NULL)->mark = r->clear ? -1.0 : r->mark;
+        }
+        st->items += b->count;
+        st->busy_ns += now_ns() - t0;
+        ring_push(&p->free_blocks, b);
+    }
+}
+
+/* -------------------- Driver -------------------- */
+
+int pipeline_load_marks(ModuleList *modules, FILE *in, int clear_on_empty, PipelineStats *stats) {
+    Pipeline *p = calloc(1, sizeof *p);
+    if (!p) return 0;
+    p->modules = modules;
+    p->in = in;
+    p->clear_on_empty = clear_on_empty;
+    ring_init(&p->free_blocks);
+    ring_init(&p->read_blocks);
+    ring_init(&p->rows_blocks);
+    atomic_init(&p->failed, 0);
+
+    int ok = 1;
+    for (size_t i = 0; i < PIPELINE_BLOCKS && ok; i++) {
+        PipeBlock *b = &p->blocks[i];
+        b->data = malloc(PIPELINE_BLOCK_SIZE);
+        b->cap = PIPELINE_BLOCK_SIZE;
+        ok = b->data != NULL;
+        ring_push(&p->free_blocks, b);
+    }
+
+    pthread_t reader, tokenizer;
+    if (ok && pthread_create(&reader, NULL, read_stage, p) != 0) ok = 0;
+    if (ok && pthread_create(&tokenizer, NULL, tokenize_stage, p) != 0) {
+        // the reader stops at its next block and its NULL ends the stream
+        atomic_store(&p->failed, 1);
+        void *b;
+        while ((b = ring_pop(&p->read_blocks, &p->stats.stage[PIPELINE_TOKENIZE].wait_in_ns)) != NULL)
+            ring_push(&p->free_blocks, b);
+        pthread_join(reader, NULL);
+        ok = 0;
+    }
+    if (ok) {
+        resolve_stage(p);
+        pthread_join(reader, NULL);
+        pthread_join(tokenizer, NULL);
+        ok = !atomic_load(&p->failed);
+    }
+
+    if (stats) *stats = p->stats;
+    for (size_t i = 0; i < PIPELINE_BLOCKS; i++) block_free(&p->blocks[i]);
+    ring_destroy(&p->free_blocks);
+    ring_destroy(&p->read_blocks);
+    ring_destroy(&p->rows_blocks);
+    free(p);
+    return ok;
+}
+
+static const char *const STAGE_NAMES[PIPELINE_STAGES] = { "read", "tokenize", "resolve" };
+static const char *const STAGE_UNITS[PIPELINE_STAGES] = { "bytes", "rows", "rows" };
+
+void pipeline_stats_print(const PipelineStats *stats, FILE *out) {
+    size_t slowest = 0;
+    for (size_t s = 1; s < PIPELINE_STAGES; s++)
+        if (stats->stage[s].busy_ns > stats->stage[slowest].busy_ns) slowest = s;
+
+    for (size_t s = 0; s < PIPELINE_STAGES; s++) {
+        const PipelineStageStats *st = &stats->stage[s];
+        double busy = (double)st->busy_ns * 1e-9;
+        fprintf(out, "  pipeline %-8s %12zu %-5s %8.3f s busy %12.0f /s  waited %.3f s in, %.3f s out%s\n",
+                STAGE_NAMES[s], st->items, STAGE_UNITS[s], busy,
+                busy > 0.0 ? (double)st->items / busy : 0.0,
+                (double)st->wait_in_ns * 1e-9, (double)st->wait_out_ns * 1e-9,
+                s == slowest ? "  <- bottleneck" : "");
+    }
+}
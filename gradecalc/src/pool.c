@@ -0,0 +1,126 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t lo, hi;  // chunks [lo, hi) still queued
+} Deque;
+
+typedef struct {
+    Deque *deques;
+    unsigned nthreads;
+    size_t n;
+    size_t grain;
+    PoolRangeFn fn;
+    void *ctx;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    unsigned id;
+} Worker;
+
+static int deque_pop_front(Deque *d, size_t *chunk) {
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->lo < d->hi) { *chunk = d->lo++; ok = 1; }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static int deque_steal_back(Deque *d, size_t *chunk) {
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->lo < d->hi) { *chunk = --d->hi; ok = 1; }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static void run_chunk(Pool *p, size_t chunk, unsigned worker) {
+    size_t begin = chunk * p->grain;
+    size_t end = begin + p->grain;
+    if (end > p->n) end = p->n;
+    p->fn(p->ctx, begin, end, worker);
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = (Worker *)arg;
+    Pool *p = w->pool;
+    size_t chunk = 0;
+
+    while (1) {
+        while (deque_pop_front(&p->deques[w->id], &chunk)) run_chunk(p, chunk, w->id);
+
+        // Own deque is empty: steal one chunk from the next non-empty victim.
+        // No new work is ever queued, so a full pass with nothing stolen means done.
+        int stole = 0;
+        for (unsigned k = 1; k < p->nthreads && !stole; k++) {
+            unsigned victim = (w->id + k) % p->nthreads;
+            if (deque_steal_back(&p->deques[victim], &chunk)) {
+                run_chunk(p, chunk, w->id);
+                stole = 1;
+            }
+        }
+        if (!stole) return NULL;
+    }
+}
+
+int pool_parallel_for(unsigned nthreads, size_t n, size_t grain, PoolRangeFn fn, void *ctx) {
+    if (n == 0) return 1;
+    if (grain == 0) grain = 1;
+
+    size_t chunks = (n + grain - 1) / grain;
+    if (nthreads == 0) nthreads = 1;
+    if (nthreads > chunks) nthreads = (unsigned)chunks;
+
+    if (nthreads == 1) {
+        fn(ctx, 0, n, 0);
+        return 1;
+    }
+
+    Pool p = { NULL, nthreads, n, grain, fn, ctx };
+    p.deques = malloc(nthreads * sizeof(Deque));
+    Worker *workers = malloc(nthreads * sizeof(Worker));
+    pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+    if (!p.deques || !workers || !threads) {
+        free(p.deques);
+        free(workers);
+        free(threads);
+        return 0;
+    }
+
+    for (unsigned t = 0; t < nthreads; t++) {
+        pthread_mutex_init(&p.deques[t].lock, NULL);
+        p.deques[t].lo = chunks * t / nthreads;
+        p.deques[t].hi = chunks * (t + 1) / nthreads;
+        workers[t].pool = &p;
+        workers[t].id = t;
+    }
+
+    unsigned started = 1;
+    for (; started < nthreads; started++) {
+        if (pthread_create(&threads[started], NULL, worker_main, &workers[started]) != 0) break;
+    }
+
+    // Worker 0 runs on the calling thread; if some threads failed to start,
+    // their chunks are simply stolen by the others.
+    worker_main(&workers[0]);
+
+    for (unsigned t = 1; t < started; t++) pthread_join(threads[t], NULL);
+    for (unsigned t = 0; t < nthreads; t++) pthread_mutex_destroy(&p.deques[t].lock);
+
+    free(p.deques);
+    free(workers);
+    free(threads);
+    return 1;
+}
+
+unsigned pool_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (unsigned)n : 1;
+}
@@ -0,0 +1,252 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "grades.h"
+#include "config.h"
+#include "calc.h"
+#include "cache.h"
+#include "num.h"
+#include "report.h"
+#include "stats.h"
+
+int report_parse_format(const char *name, ReportFormat *fmt) {
+    if (strcmp(name, "csv") == 0) {
+        *fmt = REPORT_CSV;
+        return 1;
+    }
+    if (strcmp(name, "jsonl") == 0 || strcmp(name, "json") == 0) {
+        *fmt = REPORT_JSONL;
+        return 1;
+    }
+    return 0;
+}
+
+/* -------------------- Buffered writer -------------------- */
+
+void outbuf_init(OutBuf *ob, FILE *out) {
+    ob->out = out;
+    ob->len = 0;
+    ob->error = 0;
+}
+
+static void outbuf_drain(OutBuf *ob) {
+    if (ob->len > 0 && fwrite(ob->buf, 1, ob->len, ob->out) != ob->len) ob->error = 1;
+    STATS_ADD(STAT_BYTES_WRITTEN, ob->len);
+    ob->len = 0;
+}
+
+void outbuf_put(OutBuf *ob, const char *s, size_t n) {
+    if (n > OUTBUF_SIZE - ob->len) {
+        outbuf_drain(ob);
+        if (n > OUTBUF_SIZE) {
+            if (fwrite(s, 1, n, ob->out) != n) ob->error = 1;
+            return;
+        }
+    }
+    memcpy(ob->buf + ob->len, s, n);
+    ob->len += n;
+}
+
+void outbuf_str(OutBuf *ob, const char *s) {
+    outbuf_put(ob, s, strlen(s));
+}
+
+void outbuf_char(OutBuf *ob, char c) {
+    if (ob->len == OUTBUF_SIZE) outbuf_drain(ob);
+    ob->buf[ob->len++] = c;
+}
+
+void outbuf_num(OutBuf *ob, double v) {
+    char tmp[FIXED2_TEXT_MAX];
+    outbuf_put(ob, tmp, format_fixed2(tmp, v));
+}
+
+void outbuf_int(OutBuf *ob, long v) {
+    char tmp[24];
+    int n = snprintf(tmp, sizeof tmp, "%ld", v);
+    if (n > 0) outbuf_put(ob, tmp, (size_t)n);
+}
+
+void outbuf_csv_field(OutBuf *ob, const char *s) {
+    if (!strpbrk(s, ",\"\r\n")) {
+        outbuf_str(ob, s);
+        return;
+    }
+    outbuf_char(ob, '"');
+    for (; *s; s++) {
+        if (*s == '"') outbuf_char(ob, '"');
+        outbuf_char(ob, *s);
+    }
+    outbuf_char(ob, '"');
+}
+
+void outbuf_json_string(OutBuf *ob, const char *s) {
+    outbuf_char(ob, '"');
+    for (; *s; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') {
+            outbuf_char(ob, '\\');
+            outbuf_char(ob, (char)ch);
+        } else if (ch < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof esc, "\\u%04x", ch);
+            outbuf_put(ob, esc, 6);
+        } else {
+            outbuf_char(ob, (char)ch);
+        }
+    }
+    outbuf_char(ob, '"');
+}
+
+int outbuf_flush(OutBuf *ob) {
+    outbuf_drain(ob);
+    if (fflush(ob->out) != 0) ob->error = 1;
+    return !ob->error;
+}
+
+/* -------------------- Batch report -------------------- */
+
+// One record: CSV line or JSON object. Missing figures (no marks yet,
+// nothing remaining) are empty in CSV and null in JSON.
+typedef struct {
+    const char *module;
+    const char *title;
+    double credits;
+    double current_avg;
+    double earned;
+    double remaining_weight;
+    double needed_avg;
+} ReportRecord;
+
+static void put_field(OutBuf *ob, ReportFormat fmt, const char *key, double v) {
+    if (fmt == REPORT_CSV) {
+        outbuf_char(ob, ',');
+        if (isfinite(v)) outbuf_num(ob, v);
+        return;
+    }
+    outbuf_str(ob, ",\"");
+    outbuf_str(ob, key);
+    outbuf_str(ob, "\":");
+    if (isfinite(v)) outbuf_num(ob, v);
+    else outbuf_str(ob, "null");
+}
+
+static void put_record(OutBuf *ob, ReportFormat fmt, const ReportRecord *r) {
+    if (fmt == REPORT_CSV) {
+        outbuf_csv_field(ob, r->module);
+        outbuf_char(ob, ',');
+        outbuf_csv_field(ob, r->title);
+        outbuf_char(ob, ',');
+        outbuf_int(ob, (long)r->credits);
+    } else {
+        outbuf_str(ob, "{\"module\":");
+        outbuf_json_string(ob, r->module);
+        outbuf_str(ob, ",\"title\":");
+        outbuf_json_string(ob, r->title);
+        outbuf_str(ob, ",\"credits\":");
+        outbuf_int(ob, (long)r->credits);
+    }
+
+    put_field(ob, fmt, "current_avg", r->current_avg);
+    put_field(ob, fmt, "earned", r->earned);
+    put_field(ob, fmt, "remaining_weight", r->remaining_weight);
+    put_field(ob, fmt, "needed_avg", r->needed_avg);
+
+    if (fmt == REPORT_JSONL) outbuf_char(ob, '}');
+    outbuf_char(ob, '\n');
+}
+
+int report_batch(ModuleList *modules, const Config *cfg, ReportFormat fmt, FILE *out) {
+    const double TARGET = cfg->target;
+
+    ReportCache cache;
+    if (!report_cache_init(&cache, modules)) {
+        fprintf(stderr, "Out of memory preparing report\n");
+        return 0;
+    }
+
+    OutBuf *ob = malloc(sizeof *ob);
+    if (!ob) {
+        fprintf(stderr, "Out of memory preparing report\n");
+        report_cache_free(&cache);
+        return 0;
+    }
+    outbuf_init(ob, out);
+
+    if (fmt == REPORT_CSV)
+        outbuf_str(ob, "module,title,credits,current_avg,earned,remaining_weight,needed_avg\n");
+
+    // Same cases as print_module_stats / print_overall_summary
+    for (size_t i = 0; i < modules->count; i++) {
+        const Module *m = &modules->items[i];
+        const ModuleSums *ms = report_cache_module(&cache, i);
+
+        ReportRecord r = { m->code, m->title, (double)m->credits,
+                           NAN, ms->S / 100.0, ms->R, NAN };
+        if (ms->W > 0.0) r.current_avg = ms->S / ms->W;
+        if (ms->R > 0.0) r.needed_avg = ms->W > 0.0 ? (TARGET * 100.0 - ms->S) / ms->R : TARGET;
+        put_record(ob, fmt, &r);
+    }
+
+    const OverallSums *o = &cache.overall;
+    ReportRecord r = { "OVERALL", "", o->total_credits,
+                       NAN, o->A / o->total_credits, o->B / o->total_credits * 100.0, NAN };
+    if (o->credit_W > 0.0) r.current_avg = o->credit_S / o->credit_W;
+    if (o->B > 0.0) r.needed_avg = (TARGET * o->total_credits - o->A) / o->B;
+    put_record(ob, fmt, &r);
+
+    int ok = outbuf_flush(ob);
+    if (!ok) fprintf(stderr, "Failed to write report\n");
+
+    free(ob);
+    report_cache_free(&cache);
+    return ok;
+}
+
+int report_component_ids(const ModuleList *modules, ReportFormat fmt, FILE *out) {
+    OutBuf *ob = malloc(sizeof *ob);
+    if (!ob) {
+        fprintf(stderr, "Out of memory preparing report\n");
+        return 0;
+    }
+    outbuf_init(ob, out);
+
+    char tag[DICTIONARY_TAG_MAX];
+    module_list_dictionary_tag(modules, tag);
+    if (fmt == REPORT_CSV) {
+        outbuf_str(ob, "component_id:");
+        outbuf_str(ob, tag);
+        outbuf_str(ob, ",module_id,component_name\n");
+    } else {
+        outbuf_str(ob, "{\"dictionary\":");
+        outbuf_json_string(ob, tag);
+        outbuf_str(ob, "}\n");
+    }
+    for (size_t id = 0; id < modules->component_total; id++) {
+        const ComponentRef *r = &modules->component_refs[id];
+        const char *name = modules->items[r->module].components[r->component].name;
+        if (fmt == REPORT_CSV) {
+            outbuf_int(ob, (long)id);
+            outbuf_char(ob, ',');
+            outbuf_int(ob, r->module_id);
+            outbuf_char(ob, ',');
+            outbuf_csv_field(ob, name);
+        } else {
+            outbuf_str(ob, "{\"component_id\":");
+            outbuf_int(ob, (long)id);
+            outbuf_str(ob, ",\"module_id\":");
+            outbuf_int(ob, r->module_id);
+            outbuf_str(ob, ",\"component_name\":");
+            outbuf_json_string(ob, name);
+            outbuf_char(ob, '}');
+        }
+        outbuf_char(ob, '\n');
+    }
+
+    int ok = outbuf_flush(ob);
+    if (!ok) fprintf(stderr, "Failed to write report\n");
+    free(ob);
+    return ok;
+}
@@ -0,0 +1,277 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+
+/*
+Snapshot layout (native byte order, checked by the endian marker):
+  SnapHeader
+  SnapModule[module_count]
+  SnapComponent[component_count]   grouped by module, in load order
+  string table                     NUL-terminated code/title/name strings
+The checksum is FNV-1a over everything after the header.
+*/
+
+#define SNAP_MAGIC   "GRDCSNAP"
+#define SNAP_VERSION 1u
+#define SNAP_ENDIAN  0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t checksum;
+    uint64_t payload_size;
+    SnapshotStamp stamps[SNAPSHOT_SOURCES];
+    uint32_t module_count;
+    uint32_t component_count;
+    uint64_t strings_size;
+} SnapHeader;
+
+typedef struct {
+    int32_t id;
+    int32_t credits;
+    uint32_t code_off;
+    uint32_t title_off;
+    uint32_t first_component;
+    uint32_t component_count;
+} SnapModule;
+
+typedef struct {
+    double weight;
+    double mark;
+    int32_t group_id;
+    int32_t best_of;
+    uint32_t name_off;
+    uint32_t pad;
+} SnapComponent;
+
+#define FNV_OFFSET 1469598103934665603ULL
+
+static uint64_t fnv1a(uint64_t h, const unsigned char *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void snapshot_stamp_file(const char *path, SnapshotStamp *out) {
+    struct stat st;
+    memset(out, 0, sizeof *out);
+    if (stat(path, &st) != 0) {
+        out->size = -1;
+        return;
+    }
+    out->size = (long long)st.st_size;
+    out->mtime_sec = (long long)st.st_mtim.tv_sec;
+    out->mtime_nsec = (long long)st.st_mtim.tv_nsec;
+    out->ino = (long long)st.st_ino;
+}
+
+int snapshot_same_file(const char *a, const char *b) {
+    if (strcmp(a, b) == 0) return 1;
+    struct stat sa, sb;
+    return stat(a, &sa) == 0 && stat(b, &sb) == 0 &&
+           sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+}
+
+void snapshot_stamp_sources(const SnapshotSources *src, SnapshotStamp stamps[SNAPSHOT_SOURCES]) {
+    char jpath[4096];
+    snprintf(jpath, sizeof jpath, "%s.journal", src->marks);
+
+    snapshot_stamp_file(src->modules, &stamps[0]);
+    snapshot_stamp_file(src->components, &stamps[1]);
+    snapshot_stamp_file(src->marks, &stamps[2]);
+    snapshot_stamp_file(jpath, &stamps[3]);
+}
+
+/* -------------------- Load -------------------- */
+
+static int snapshot_fill(ModuleList *modules, const SnapHeader *h, const unsigned char *payload) {
+    const SnapModule *sm = (const SnapModule *)payload;
+    const SnapComponent *sc = (const SnapComponent *)(sm + h->module_count);
+    const char *strings = (const char *)(sc + h->component_count);
+
+    // Offsets are checked against strings_size, but each string is read up
+    // to its NUL: without one at the end the last could run off the mapping
+    if (h->strings_size != 0 && strings[h->strings_size - 1] != '\0') return 0;
+    if (!module_list_reserve(modules, modules->count + h->module_count)) return 0;
+
+    for (uint32_t i = 0; i < h->module_count; i++) {
+        if (sm[i].code_off >= h->strings_size || sm[i].title_off >= h->strings_size) return 0;
+        if (sm[i].first_component > h->component_count ||
+            sm[i].component_count > h->component_count - sm[i].first_component) return 0;
+
+        Module m = (Module){0};
+        m.id = sm[i].id;
+        m.credits = sm[i].credits;
+        snprintf(m.code, sizeof m.code, "%s", strings + sm[i].code_off);
+        snprintf(m.title, sizeof m.title, "%s", strings + sm[i].title_off);
+        if (!module_list_push(modules, &m)) return 0;
+
+        Module *dst = &modules->items[modules->count - 1];
+        if (!module_reserve_components(dst, sm[i].component_count)) return 0;
+        for (uint32_t k = 0; k < sm[i].component_count; k++) {
+            const SnapComponent *r = &sc[sm[i].first_component + k];
+            if (r->name_off >= h->strings_size) return 0;
+
+            Component c = (Component){0};
+            snprintf(c.name, sizeof c.name, "%s", strings + r->name_off);
+            c.weight = r->weight;
+            c.mark = r->mark;
+            c.group_id = r->group_id;
+            c.best_of = r->best_of;
+            if (!module_add_component(dst, &c)) return 0;
+        }
+    }
+    return module_list_build_groups(modules) && module_list_index_components(modules);
+}
+
+int snapshot_load(ModuleList *modules, const char *snap_path,
+                  const SnapshotSources *src, SnapshotStamp stamps[SNAPSHOT_SOURCES]) {
+    snapshot_stamp_sources(src, stamps);
+
+    int fd = open(snap_path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    size_t len = (size_t)st.st_size;
+    void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    const SnapHeader *h = (const SnapHeader *)map;
+    const unsigned char *payload = (const unsigned char *)map + sizeof(SnapHeader);
+
+    int ok = memcmp(h->magic, SNAP_MAGIC, sizeof h->magic) == 0 &&
+             h->version == SNAP_VERSION &&
+             h->endian == SNAP_ENDIAN &&
+             h->payload_size == len - sizeof(SnapHeader) &&
+             h->payload_size == (uint64_t)h->module_count * sizeof(SnapModule) +
+                                (uint64_t)h->component_count * sizeof(SnapComponent) +
+                                h->strings_size &&
+             memcmp(h->stamps, stamps, sizeof h->stamps) == 0 &&
+             fnv1a(FNV_OFFSET, payload, (size_t)h->payload_size) == h->checksum;
+
+    if (ok) {
+        // The header gives the exact sizes the CSV path has to count lines for
+        size_t hint = module_list_arena_hint(h->module_count, h->component_count);
+        if (!module_list_init_arena(modules, hint)) module_list_init(modules);
+        ok = snapshot_fill(modules, h, payload);
+        if (!ok) module_list_free(modules);
+    }
+
+    munmap(map, len);
+    return ok;
+}
+
+/* -------------------- Save -------------------- */
+
+typedef struct {
+    char *data;
+    size_t len, cap;
+} StrTab;
+
+// Appends s and returns its offset, or UINT32_MAX if out of memory
+static uint32_t strtab_add(StrTab *t, const char *s) {
+    size_t n = strlen(s) + 1;
+    if (t->len + n > t->cap) {
+        size_t newcap = t->cap ? t->cap * 2 : 4096;
+        while (newcap < t->len + n) newcap *= 2;
+        char *nd = realloc(t->data, newcap);
+        if (!nd) return UINT32_MAX;
+        t->data = nd;
+        t->cap = newcap;
+    }
+    memcpy(t->data + t->len, s, n);
+    uint32_t off = (uint32_t)t->len;
+    t->len += n;
+    return off;
+}
+
+int snapshot_save(const ModuleList *modules, const char *snap_path,
+                  const SnapshotStamp stamps[SNAPSHOT_SOURCES]) {
+    size_t ncomp = 0;
+    for (size_t i = 0; i < modules->count; i++) ncomp += modules->items[i].component_count;
+
+    size_t records = modules->count * sizeof(SnapModule) + ncomp * sizeof(SnapComponent);
+    unsigned char *buf = calloc(records ? records : 1, 1);
+    StrTab strs = { NULL, 0, 0 };
+    if (!buf) return 0;
+
+    SnapModule *sm = (SnapModule *)buf;
+    SnapComponent *sc = (SnapComponent *)(sm + modules->count);
+    int ok = 1;
+
+    size_t at = 0;
+    for (size_t i = 0; i < modules->count && ok; i++) {
+        const Module *m = &modules->items[i];
+        sm[i].id = m->id;
+        sm[i].credits = m->credits;
+        sm[i].code_off = strtab_add(&strs, m->code);
+        sm[i].title_off = strtab_add(&strs, m->title);
+        sm[i].first_component = (uint32_t)at;
+        sm[i].component_count = (uint32_t)m->component_count;
+        ok = sm[i].code_off != UINT32_MAX && sm[i].title_off != UINT32_MAX;
+
+        for (size_t k = 0; k < m->component_count && ok; k++, at++) {
+            const Component *c = &m->components[k];
+            sc[at].weight = c->weight;
+            sc[at].mark = c->mark;
+            sc[at].group_id = c->group_id;
+            sc[at].best_of = c->best_of;
+            sc[at].name_off = strtab_add(&strs, c->name);
+            ok = sc[at].name_off != UINT32_MAX;
+        }
+    }
+
+    char tmp[4096];
+    snprintf(tmp, sizeof tmp, "%s.tmp", snap_path);
+    FILE *fp = ok ? fopen(tmp, "wb") : NULL;
+
+    if (fp) {
+        SnapHeader h;
+        memset(&h, 0, sizeof h);
+        memcpy(h.magic, SNAP_MAGIC, sizeof h.magic);
+        h.version = SNAP_VERSION;
+        h.endian = SNAP_ENDIAN;
+        h.payload_size = records + strs.len;
+        memcpy(h.stamps, stamps, sizeof h.stamps);
+        h.module_count = (uint32_t)modules->count;
+        h.component_count = (uint32_t)ncomp;
+        h.strings_size = strs.len;
+
+        // checksum runs over records then strings, as they sit in the file
+        h.checksum = fnv1a(fnv1a(FNV_OFFSET, buf, records),
+                           (const unsigned char *)strs.data, strs.len);
+
+        ok = fwrite(&h, sizeof h, 1, fp) == 1 &&
+             fwrite(buf, 1, records, fp) == records &&
+             fwrite(strs.data, 1, strs.len, fp) == strs.len;
+        if (fclose(fp) != 0) ok = 0;
+        if (!ok || rename(tmp, snap_path) != 0) {
+            remove(tmp);
+            ok = 0;
+        }
+    } else {
+        ok = 0;
+    }
+
+    free(buf);
+    free(strs.data);
+    return ok;
+}
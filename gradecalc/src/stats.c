@@ -0,0 +1,127 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "stats.h"
+
+#ifdef GRADECALC_STATS
+
+#include <pthread.h>
+
+_Thread_local StatBlock *stats_local;
+
+static StatBlock *all_blocks;   // threads still running
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Counts of exited threads, and how many there were
+static StatBlock retired;
+static unsigned retired_threads;
+
+// Blocks that cannot be allocated count into this shared fallback
+static StatBlock overflow_block;
+
+static pthread_key_t block_key;
+static pthread_once_t block_key_once = PTHREAD_ONCE_INIT;
+
+static void block_add(StatBlock *to, const StatBlock *from) {
+    for (int c = 0; c < STAT_COUNTERS; c++) to->counter[c] += from->counter[c];
+    for (int p = 0; p < STAT_PHASES; p++) {
+        to->phase_ns[p] += from->phase_ns[p];
+        to->phase_calls[p] += from->phase_calls[p];
+    }
+}
+
+// Thread exit: fold the block into retired and free it
+static void block_retire(void *arg) {
+    StatBlock *b = arg;
+
+    pthread_mutex_lock(&blocks_lock);
+    for (StatBlock **link = &all_blocks; *link; link = &(*link)->next) {
+        if (*link == b) {
+            *link = b->next;
+            break;
+        }
+    }
+    block_add(&retired, b);
+    retired_threads++;
+    pthread_mutex_unlock(&blocks_lock);
+
+    stats_local = NULL;
+    free(b);
+}
+
+static void make_block_key(void) {
+    pthread_key_create(&block_key, block_retire);
+}
+
+StatBlock *stats_register(void) {
+    pthread_once(&block_key_once, make_block_key);
+
+    StatBlock *b = calloc(1, sizeof *b);
+    if (!b) return &overflow_block;
+
+    pthread_mutex_lock(&blocks_lock);
+    b->next = all_blocks;
+    all_blocks = b;
+    pthread_mutex_unlock(&blocks_lock);
+
+    pthread_setspecific(block_key, b);
+    stats_local = b;
+    return b;
+}
+
+unsigned long long stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+void stats_phase_add(StatPhase phase, unsigned long long ns) {
+    StatBlock *b = stats_block();
+    b->phase_ns[phase] += ns;
+    b->phase_calls[phase]++;
+}
+
+static const char *const COUNTER_NAMES[STAT_COUNTERS] = {
+    "rows parsed", "fields allocated", "hash lookups", "hash probes",
+    "linear lookups", "top-k selections", "bytes read", "bytes written"
+};
+
+static const char *const PHASE_NAMES[STAT_PHASES] = {
+    "load_modules", "load_components", "load_marks", "evaluation", "save"
+};
+
+void stats_dump(FILE *out) {
+    StatBlock total = { { 0 }, { 0 }, { 0 }, NULL };
+    unsigned threads = 0;
+
+    pthread_mutex_lock(&blocks_lock);
+    for (const StatBlock *b = all_blocks; b; b = b->next, threads++) block_add(&total, b);
+    block_add(&total, &retired);
+    threads += retired_threads;
+    pthread_mutex_unlock(&blocks_lock);
+
+    block_add(&total, &overflow_block);
+
+    fprintf(out, "---- gradecalc stats (%u thread%s) ----\n", threads, threads == 1 ? "" : "s");
+    for (int c = 0; c < STAT_COUNTERS; c++)
+        fprintf(out, "  %-18s %llu\n", COUNTER_NAMES[c], total.counter[c]);
+    for (int p = 0; p < STAT_PHASES; p++) {
+        if (total.phase_calls[p] == 0) continue;
+        fprintf(out, "  %-18s %.3f ms (%llu call%s)\n", PHASE_NAMES[p],
+                (double)total.phase_ns[p] / 1e6, total.phase_calls[p],
+                total.phase_calls[p] == 1 ? "" : "s");
+    }
+}
+
+static void dump_to_stderr(void) {
+    stats_dump(stderr);
+}
+
+void stats_dump_at_exit(void) {
+    atexit(dump_to_stderr);
+}
+
+#endif
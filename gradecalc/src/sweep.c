@@ -0,0 +1,251 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "grades.h"
+#include "calc.h"
+#include "cache.h"
+#include "cohort.h"
+#include "report.h"
+#include "sweep.h"
+
+// Grids beyond this many points are almost certainly a typo in the step
+#define SWEEP_MAX_POINTS 1000000
+
+int sweep_parse_axis(const char *spec, SweepAxis *ax) {
+    char *end = NULL;
+    double from = strtod(spec, &end);
+    if (end == spec) return 0;
+    if (*end == '\0') {
+        sweep_axis_fixed(ax, from);
+        return 1;
+    }
+    if (*end != ':') return 0;
+
+    const char *p = end + 1;
+    double to = strtod(p, &end);
+    if (end == p || *end != ':') return 0;
+
+    p = end + 1;
+    double step = strtod(p, &end);
+    if (end == p || *end != '\0') return 0;
+    if (!(step > 0.0) || !(to >= from)) return 0;
+
+    // Small slack so 50:80:0.1 still ends on 80 despite rounding
+    double n = floor((to - from) / step + 1e-9) + 1.0;
+    if (n > SWEEP_MAX_POINTS) return 0;
+
+    ax->from = from;
+    ax->step = step;
+    ax->count = (size_t)n;
+    return 1;
+}
+
+void sweep_axis_fixed(SweepAxis *ax, double value) {
+    ax->from = value;
+    ax->step = 0.0;
+    ax->count = 1;
+}
+
+/* -------------------- Terms -------------------- */
+
+void sweep_terms_init(SweepTerms *t) {
+    t->items = NULL;
+    t->count = 0;
+    t->capacity = 0;
+}
+
+void sweep_terms_free(SweepTerms *t) {
+    free(t->items);
+    sweep_terms_init(t);
+}
+
+static int push_term(SweepTerms *t, const Module *m, const Component *comp,
+                     double a, double b, double c) {
+    if (t->count == t->capacity) {
+        size_t cap = t->capacity ? t->capacity * 2 : 64;
+        SweepTerm *items = realloc(t->items, cap * sizeof(SweepTerm));
+        if (!items) return 0;
+        t->items = items;
+        t->capacity = cap;
+    }
+    t->items[t->count++] = (SweepTerm){ m, comp, a, b, c };
+    return 1;
+}
+
+// Same cases as print_module_stats, with T and A left symbolic
+int sweep_add_module(SweepTerms *t, const Module *m, const double *marks, const ModuleSums *ms) {
+    const double S = ms->S, W = ms->W, R = ms->R;
+
+    if (R <= 0.0) return 1;                              // final mark, nothing needed
+    if (W <= 0.0) return push_term(t, m, NULL, 0.0, 1.0, 0.0);
+
+    if (!push_term(t, m, NULL, -S / R, 100.0 / R, 0.0)) return 0;
+
+    for (size_t i = 0; i < m->component_count; i++) {
+        const Component *c = &m->components[i];
+        double mark = marks ? marks[i] : c->mark;
+        if (mark >= 0.0) continue;
+        if (c->group_id != 0 && c->best_of != 0) continue;
+        if (c->weight <= 0.0) continue;
+
+        // required = (T * 100 - S - A * (R - w)) / w
+        const double w = c->weight;
+        if (!push_term(t, m, c, -S / w, 100.0 / w, -(R - w) / w)) return 0;
+    }
+    return 1;
+}
+
+int sweep_add_overall(SweepTerms *t, const OverallSums *o) {
+    if (o->B <= 0.0) return 1;
+    return push_term(t, NULL, NULL, -o->A / o->B, o->total_credits / o->B, 0.0);
+}
+
+/* -------------------- Output -------------------- */
+
+void sweep_write_header(OutBuf *ob, ReportFormat fmt, int with_student) {
+    if (fmt != REPORT_CSV) return;
+    if (with_student) outbuf_str(ob, "student_id,");
+    outbuf_str(ob, "target,assume_other,module,component,needed\n");
+}
+
+static void write_record(OutBuf *ob, ReportFormat fmt, const char *sid, double T, double A,
+                         const SweepTerm *term, double needed) {
+    const char *module = term->module ? term->module->code : "OVERALL";
+
+    if (fmt == REPORT_CSV) {
+        if (sid) {
+            outbuf_csv_field(ob, sid);
+            outbuf_char(ob, ',');
+        }
+        outbuf_num(ob, T);
+        outbuf_char(ob, ',');
+        outbuf_num(ob, A);
+        outbuf_char(ob, ',');
+        outbuf_csv_field(ob, module);
+        outbuf_char(ob, ',');
+        if (term->component) outbuf_csv_field(ob, term->component->name);
+        outbuf_char(ob, ',');
+        outbuf_num(ob, needed);
+        outbuf_char(ob, '\n');
+        return;
+    }
+
+    outbuf_char(ob, '{');
+    if (sid) {
+        outbuf_str(ob, "\"student_id\":");
+        outbuf_json_string(ob, sid);
+        outbuf_char(ob, ',');
+    }
+    outbuf_str(ob, "\"target\":");
+    outbuf_num(ob, T);
+    outbuf_str(ob, ",\"assume_other\":");
+    outbuf_num(ob, A);
+    outbuf_str(ob, ",\"module\":");
+    outbuf_json_string(ob, module);
+    outbuf_str(ob, ",\"component\":");
+    if (term->component) outbuf_json_string(ob, term->component->name);
+    else outbuf_str(ob, "null");
+    outbuf_str(ob, ",\"needed\":");
+    outbuf_num(ob, needed);
+    outbuf_str(ob, "}\n");
+}
+
+void sweep_write(OutBuf *ob, ReportFormat fmt, const char *sid, const SweepTerms *t,
+                 const SweepAxis *target, const SweepAxis *assume) {
+    for (size_t i = 0; i < target->count; i++) {
+        const double T = target->from + (double)i * target->step;
+        for (size_t j = 0; j < assume->count; j++) {
+            const double A = assume->from + (double)j * assume->step;
+            for (size_t k = 0; k < t->count; k++) {
+                const SweepTerm *term = &t->items[k];
+                write_record(ob, fmt, sid, T, A, term, term->a + term->b * T + term->c * A);
+            }
+        }
+    }
+}
+
+/* -------------------- Drivers -------------------- */
+
+int sweep_report(ModuleList *modules, const SweepAxis *target, const SweepAxis *assume,
+                 ReportFormat fmt, FILE *out) {
+    ReportCache cache;
+    if (!report_cache_init(&cache, modules)) {
+        fprintf(stderr, "Out of memory preparing report\n");
+        return 0;
+    }
+
+    SweepTerms terms;
+    sweep_terms_init(&terms);
+
+    int ok = 1;
+    for (size_t i = 0; i < modules->count && ok; i++)
+        ok = sweep_add_module(&terms, &modules->items[i], NULL, report_cache_module(&cache, i));
+    if (ok) ok = sweep_add_overall(&terms, &cache.overall);
+
+    OutBuf *ob = ok ? malloc(sizeof *ob) : NULL;
+    if (!ob) {
+        fprintf(stderr, "Out of memory preparing report\n");
+        sweep_terms_free(&terms);
+        report_cache_free(&cache);
+        return 0;
+    }
+
+    outbuf_init(ob, out);
+    sweep_write_header(ob, fmt, 0);
+    sweep_write(ob, fmt, NULL, &terms, target, assume);
+
+    ok = outbuf_flush(ob);
+    if (!ok) fprintf(stderr, "Failed to write report\n");
+
+    free(ob);
+    sweep_terms_free(&terms);
+    report_cache_free(&cache);
+    return ok;
+}
+
+int sweep_cohort_report(const Cohort *c, const ModuleSums *sums, const SweepAxis *target,
+                        const SweepAxis *assume, ReportFormat fmt, FILE *out) {
+    const ModuleList *schema = c->schema;
+
+    OutBuf *ob = malloc(sizeof *ob);
+    if (!ob) {
+        fprintf(stderr, "Out of memory preparing report\n");
+        return 0;
+    }
+    outbuf_init(ob, out);
+    sweep_write_header(ob, fmt, 1);
+
+    // One student's terms at a time; the buffer is reused across students
+    SweepTerms terms;
+    sweep_terms_init(&terms);
+
+    int ok = 1;
+    for (size_t s = 0; s < c->student_count && ok; s++) {
+        const double *row = cohort_row(c, s);
+        const ModuleSums *ms = sums + s * schema->count;
+
+        terms.count = 0;
+        OverallSums o;
+        overall_init(&o);
+
+        for (size_t i = 0; i < schema->count && ok; i++) {
+            const Module *m = &schema->items[i];
+            overall_add(&o, m->credits, ms[i].S, ms[i].W, ms[i].R);
+            ok = sweep_add_module(&terms, m, row + c->module_offset[i], &ms[i]);
+        }
+        if (ok) ok = sweep_add_overall(&terms, &o);
+        if (ok) sweep_write(ob, fmt, c->student_ids[s], &terms, target, assume);
+    }
+
+    if (!ok) fprintf(stderr, "Out of memory preparing report\n");
+    if (!outbuf_flush(ob)) {
+        fprintf(stderr, "Failed to write report\n");
+        ok = 0;
+    }
+
+    free(ob);
+    sweep_terms_free(&terms);
+    return ok;
+}
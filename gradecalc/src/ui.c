@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,17 +6,21 @@
 #include "grades.h"
 #include "config.h"
 #include "calc.h"
+#include "cache.h"
 #include "io.h"
+#include "stats.h"
 #include "ui.h"
+#include "watch.h"
 
 /* -------------------- Reporting -------------------- */
 
-static void print_module_stats(const Module *m, const Config *cfg) {
+// scratch holds m->max_group_size marks for the best-of solver
+static void print_module_stats(const Module *m, const ModuleSums *ms, const Config *cfg,
+                               double *scratch) {
     const double TARGET = cfg->target;
     const double ASSUME_OTHER = cfg->assume_other;
 
-    double S = 0.0, W = 0.0, R = 0.0;
-    module_sums_bestof(m, &S, &W, &R);
+    const double S = ms->S, W = ms->W, R = ms->R;
 
     printf("%s (%d credits)\n", m->title, m->credits);
 
@@ -48,19 +53,12 @@ static void print_module_stats(const Module *m, const Config *cfg) {
     int safe_count = 0;
     double safe_weight = 0.0;
 
-    int grouped_remaining_count = 0;
-    double grouped_remaining_weight = 0.0;
-
     for (size_t i = 0; i < m->component_count; i++) {
         const Component *c = &m->components[i];
         if (c->mark >= 0.0) continue;
 
-        // Grouped items: don't list individually
-        if (c->group_id != 0 && c->best_of != 0) {
-            grouped_remaining_count++;
-            grouped_remaining_weight += c->weight;
-            continue;
-        }
+        // Grouped items are solved per group below
+        if (c->group_id != 0 && c->best_of != 0) continue;
 
         if (c->weight <= 0.0) {
             printed_any = 1;
@@ -92,10 +90,32 @@ static void print_module_stats(const Module *m, const Config *cfg) {
                safe_count, safe_weight);
     }
 
-    if (grouped_remaining_count > 0) {
+    for (size_t g = 0; g < m->group_count; g++) {
+        const ComponentGroup *grp = &m->groups[g];
+        GroupRequired req;
+        if (!module_group_required(m, g, NULL, ms, TARGET, ASSUME_OTHER, scratch, &req)) {
+            if (req.remaining > 0 && grp->item_weight == 0.0) {
+                printed_any = 1;
+                printf("    - best %d of group %d (%zu remaining): cannot compute (weight is zero)\n",
+                       grp->best_of, grp->group_id, req.remaining);
+            }
+            continue;
+        }
+
         printed_any = 1;
-        printf("    - %d remaining grouped assessment item(s) (%.2f%% total) [not listed individually]\n",
-               grouped_remaining_count, grouped_remaining_weight);
+        printf("    - best %d of group %d (%zu remaining, %.2f%% each): ",
+               grp->best_of, grp->group_id, req.remaining, grp->item_weight);
+
+        if (req.uniform == -INFINITY) {
+            printf("already safe\n");
+            continue;
+        }
+        printf("need %.2f%%%s%s", req.uniform, req.remaining > 1 ? " on each remaining" : "",
+               req.uniform > 100.0 ? " (impossible)" : "");
+        if (req.remaining > 1 && req.single > -INFINITY) {
+            printf(", or %.2f%% on one%s", req.single, req.single > 100.0 ? " (impossible)" : "");
+        }
+        printf("\n");
     }
 
     if (!printed_any) {
@@ -105,38 +125,19 @@ static void print_module_stats(const Module *m, const Config *cfg) {
     printf("\n");
 }
 
-static void print_overall_summary(const ModuleList *modules, const Config *cfg) {
+static void print_overall_summary(const OverallSums *overall, const Config *cfg) {
     const double target = cfg->target;
+    const OverallSums o = *overall;
 
-    double total_credits = 0.0;
-
-    double A = 0.0;
-    double B = 0.0;
-
-    double sum_credit_S = 0.0;
-    double sum_credit_W = 0.0;
-
-    for (size_t i = 0; i < modules->count; i++) {
-        const Module *m = &modules->items[i];
-        total_credits += m->credits;
-
-        double S = 0.0, W = 0.0, R = 0.0;
-        module_sums_bestof(m, &S, &W, &R);
-
-        double earned_contribution = S / 100.0;
-
-        A += m->credits * earned_contribution;
-        B += m->credits * (R / 100.0);
-
-        sum_credit_S += m->credits * S;
-        sum_credit_W += m->credits * W;
-    }
+    const double total_credits = o.total_credits;
+    const double A = o.A;
+    const double B = o.B;
 
     printf("OVERALL (credit-weighted)\n");
     printf("  Total credits: %.0f\n", total_credits);
 
-    if (sum_credit_W > 0.0) {
-        double current_avg_marked = sum_credit_S / sum_credit_W;
+    if (o.credit_W > 0.0) {
+        double current_avg_marked = o.credit_S / o.credit_W;
         printf("  Current average on marked work (credit-weighted): %.2f%%\n", current_avg_marked);
     } else {
         printf("  Current average on marked work (credit-weighted): (no marks yet)\n");
@@ -252,27 +253,108 @@ static int pick_component_index(const Module *m) {
     return idx - 1;
 }
 
-static void show_report(const ModuleList *modules, const Config *cfg) {
+static void show_report(const ModuleList *modules, ReportCache *cache, const Config *cfg) {
+    report_cache_refresh(cache);
+
     printf("\n==== Report ====\n\n");
     printf("Target: %.2f%% | Assume other remaining: %.2f%%\n\n", cfg->target, cfg->assume_other);
 
     printf("Loaded %zu modules\n\n", modules->count);
 
     for (size_t i = 0; i < modules->count; i++) {
-        print_module_stats(&modules->items[i], cfg);
+        print_module_stats(&modules->items[i], report_cache_module(cache, i), cfg, cache->scratch);
     }
 
-    print_overall_summary(modules, cfg);
+    print_overall_summary(&cache->overall, cfg);
+}
+
+// Journaled edits before marks.csv is rewritten and the journal dropped
+#define JOURNAL_COMPACT_EVERY 64
+
+// Files in data/ rewritten by other programs while the menu is open
+typedef struct {
+    DataWatch watch;
+    MarksBase base;        // NULL base: marks.csv is not followed
+    int schema_stale;      // modules.csv or components.csv changed and failed to load
+} LiveData;
+
+static int save_marks(ModuleList *modules, LiveData *live) {
+    if (!save_marks_csv(modules, "data/marks.csv")) return 0;
+    if (live->base.base) marks_base_saved(&live->base, modules, "data/marks.csv");
+    return 1;
 }
 
-static void edit_marks_menu(ModuleList *modules, Config *cfg) {
+// Appends an edit to the journal, compacting into marks.csv every so often
+static void journal_edit(ModuleList *modules, LiveData *live, const Module *m, const Component *c,
+                         int *journaled) {
+    if (!journal_append_mark("data/marks.csv", m, c)) {
+        printf("Warning: could not journal edit; use Save to keep it.\n");
+        return;
+    }
+    if (++*journaled >= JOURNAL_COMPACT_EVERY && save_marks(modules, live)) {
+        *journaled = 0;
+    }
+}
+
+// Picks up files changed on disk since the last look. New marks go
+// through the report cache like an edit; a new schema is swapped in and
+// the cache rebuilt over it. Returns 0 if the cache cannot be rebuilt.
+static int sync_data(ModuleList *modules, ReportCache *cache, LiveData *live) {
+    unsigned changed = data_watch_poll(&live->watch);
+
+    if (changed & (WATCH_MODULES | WATCH_COMPONENTS)) {
+        // The cache is laid out by module and group, so it goes first
+        report_cache_free(cache);
+
+        SchemaReload r;
+        if (!schema_reload(modules, &live->base, "data/modules.csv", "data/components.csv", &r)) {
+            live->schema_stale = 1;
+            printf("\nCould not reload modules or components; keeping the ones loaded.\n");
+        } else {
+            live->schema_stale = 0;
+            size_t modules_moved = r.modules_added + r.modules_removed + r.modules_changed;
+            size_t components_moved = r.components_added + r.components_removed + r.components_changed;
+            if (modules_moved || components_moved) {
+                printf("\nReloaded modules (%zu added, %zu removed, %zu changed) and components "
+                       "(%zu added, %zu removed, %zu changed).\n",
+                       r.modules_added, r.modules_removed, r.modules_changed,
+                       r.components_added, r.components_removed, r.components_changed);
+                changed |= WATCH_MARKS;   // marks.csv may name the new components
+            }
+        }
+
+        if (!report_cache_init(cache, modules)) {
+            fprintf(stderr, "Out of memory preparing report\n");
+            return 0;
+        }
+    }
+    if ((changed & WATCH_MARKS) && live->base.base) {
+        MarksReload r;
+        if (!marks_reload(modules, cache, &live->base, "data/marks.csv", stdout, &r)) {
+            printf("\nCould not reload data/marks.csv\n");
+        } else if (r.applied || r.conflicts) {
+            printf("\nReloaded data/marks.csv: %zu mark(s) updated, %zu conflict(s).\n",
+                   r.applied, r.conflicts);
+        }
+    }
+    return 1;
+}
+
+static void edit_marks_menu(ModuleList *modules, ReportCache *cache, Config *cfg, LiveData *live) {
+    int journaled = 0;
+
     while (1) {
+        if (!sync_data(modules, cache, live)) return;
+
         printf("\n==== Grade Tool ====\n");
         printf("1) Edit a mark\n");
         printf("2) Show report\n");
         printf("3) Save marks\n");
         printf("4) Set target overall (currently %.0f%%)\n", cfg->target);
         printf("5) Set assumed mark for other remaining (currently %.0f%%)\n", cfg->assume_other);
+#ifdef GRADECALC_STATS
+        printf("9) Show statistics\n");
+#endif
         printf("0) Exit\n");
 
         int choice = -1;
@@ -298,17 +380,23 @@ static void edit_marks_menu(ModuleList *modules, Config *cfg) {
                 printf("Invalid mark. Must be 0–100, or blank.\n");
             } else if (rc == 2) {
                 c->mark = -1.0;
+                report_cache_mark_dirty(cache, m, (size_t)ci);
+                journal_edit(modules, live, m, c, &journaled);
                 printf("Cleared mark for '%s'.\n", c->name);
             } else {
                 c->mark = new_mark;
+                report_cache_mark_dirty(cache, m, (size_t)ci);
+                journal_edit(modules, live, m, c, &journaled);
                 printf("Set '%s' to %.2f.\n", c->name, c->mark);
             }
 
         } else if (choice == 2) {
-            show_report(modules, cfg);
+            if (!sync_data(modules, cache, live)) return;
+            show_report(modules, cache, cfg);
 
         } else if (choice == 3) {
-            if (save_marks_csv(modules, "data/marks.csv")) {
+            if (save_marks(modules, live)) {
+                journaled = 0;
                 printf("Saved data/marks.csv\n");
             } else {
                 printf("Failed to save data/marks.csv\n");
@@ -332,12 +420,35 @@ static void edit_marks_menu(ModuleList *modules, Config *cfg) {
                 printf("Invalid. Enter a number 0–100.\n");
             }
 
+#ifdef GRADECALC_STATS
+        } else if (choice == 9) {
+            STATS_DUMP(stdout);
+#endif
         } else {
             printf("Unknown choice.\n");
         }
     }
 }
 
-void ui_run(ModuleList *modules, Config *cfg) {
-    edit_marks_menu(modules, cfg);
+int ui_run(ModuleList *modules, Config *cfg) {
+    ReportCache cache;
+    if (!report_cache_init(&cache, modules)) {
+        fprintf(stderr, "Out of memory preparing report\n");
+        return 1;
+    }
+
+    // Watch first so nothing written after the base is read goes unseen
+    LiveData live = { .schema_stale = 0 };
+    if (!data_watch_open(&live.watch, "data") ||
+        !marks_base_init(&live.base, modules, "data/marks.csv")) {
+        live.base.base = NULL;
+    }
+
+    edit_marks_menu(modules, &cache, cfg, &live);
+
+    (void)sync_data(modules, &cache, &live);   // before main saves over marks.csv
+    marks_base_free(&live.base);
+    data_watch_close(&live.watch);
+    report_cache_free(&cache);
+    return !live.schema_stale;
 }
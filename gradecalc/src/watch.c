@@ -0,0 +1,282 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/inotify.h>
+#endif
+
+#include "io.h"
+#include "num.h"
+#include "watch.h"
+
+/* -------------------- Watching data/ -------------------- */
+
+#ifdef __linux__
+
+int data_watch_open(DataWatch *w, const char *dir) {
+    w->fd = -1;
+    w->wd = -1;
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return 0;
+
+    // CLOSE_WRITE: rewritten in place; MOVED_TO: written elsewhere and
+    // renamed over, as save_marks_csv and most editors do
+    int wd = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+        close(fd);
+        return 0;
+    }
+
+    w->fd = fd;
+    w->wd = wd;
+    return 1;
+}
+
+void data_watch_close(DataWatch *w) {
+    if (w->fd >= 0) close(w->fd);
+    w->fd = -1;
+    w->wd = -1;
+}
+
+static unsigned watch_bit(const char *name) {
+    if (strcmp(name, "modules.csv") == 0) return WATCH_MODULES;
+    if (strcmp(name, "components.csv") == 0) return WATCH_COMPONENTS;
+    if (strcmp(name, "marks.csv") == 0) return WATCH_MARKS;
+    return 0;   // journal, snapshot, temporaries, anything else
+}
+
+unsigned data_watch_poll(DataWatch *w) {
+    if (w->fd < 0) return 0;
+
+    unsigned changed = 0;
+    _Alignas(struct inotify_event) char buf[4096];
+
+    for (;;) {
+        ssize_t n = read(w->fd, buf, sizeof buf);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;   // EAGAIN: nothing more pending
+
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->len > 0) changed |= watch_bit(ev->name);
+            if (ev->mask & IN_Q_OVERFLOW) changed |= WATCH_MODULES | WATCH_COMPONENTS | WATCH_MARKS;
+            p += sizeof *ev + ev->len;
+        }
+    }
+    return changed;
+}
+
+#else
+
+int data_watch_open(DataWatch *w, const char *dir) {
+    (void)dir;
+    w->fd = -1;
+    w->wd = -1;
+    return 0;
+}
+
+void data_watch_close(DataWatch *w) {
+    w->fd = -1;
+    w->wd = -1;
+}
+
+unsigned data_watch_poll(DataWatch *w) {
+    (void)w;
+    return 0;
+}
+
+#endif
+
+/* -------------------- Reloading marks -------------------- */
+
+static int same_mark(double a, double b) {
+    if (a < 0.0 || b < 0.0) return a < 0.0 && b < 0.0;
+    return a == b;
+}
+
+static double *unset_marks(size_t count) {
+    double *v = malloc((count ? count : 1) * sizeof *v);
+    if (!v) return NULL;
+    for (size_t i = 0; i < count; i++) v[i] = -1.0;
+    return v;
+}
+
+static int same_stamp(const SnapshotStamp *a, const SnapshotStamp *b) {
+    return a->size == b->size && a->mtime_sec == b->mtime_sec &&
+           a->mtime_nsec == b->mtime_nsec && a->ino == b->ino;
+}
+
+int marks_base_init(MarksBase *b, ModuleList *modules, const char *path) {
+    b->count = modules->component_total;
+    b->saved.size = -1;
+    b->base = unset_marks(b->count);
+    if (!b->base) return 0;
+
+    SnapshotStamp st;
+    snapshot_stamp_file(path, &st);
+    if (st.size < 0) return 1;   // no marks.csv yet: nothing marked on disk
+    if (!load_marks_values(modules, path, b->base)) {
+        free(b->base);
+        b->base = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void marks_base_free(MarksBase *b) {
+    free(b->base);
+    b->base = NULL;
+    b->count = 0;
+}
+
+// mark as save_marks_csv writes it and load_marks reads it back
+static double written_mark(double mark) {
+    if (mark < 0.0) return -1.0;
+    char buf[FIXED2_TEXT_MAX + 1];
+    buf[format_fixed2(buf, mark)] = '\0';
+    double v;
+    return parse_double(buf, &v) ? v : mark;
+}
+
+void marks_base_saved(MarksBase *b, ModuleList *modules, const char *path) {
+    for (size_t id = 0; id < b->count; id++) {
+        b->base[id] = written_mark(module_list_component(modules, id, NULL)->mark);
+    }
+    snapshot_stamp_file(path, &b->saved);
+}
+
+int marks_reload(ModuleList *modules, ReportCache *rc, MarksBase *b, const char *path,
+                 FILE *log, MarksReload *out) {
+    out->applied = 0;
+    out->conflicts = 0;
+
+    SnapshotStamp now;
+    snapshot_stamp_file(path, &now);
+    if (b->saved.size >= 0 && same_stamp(&now, &b->saved)) return 1;   // our own save
+
+    double *disk = unset_marks(b->count);
+    if (!disk) return 0;
+    if (!load_marks_values(modules, path, disk)) {
+        free(disk);
+        return 0;
+    }
+
+    for (size_t id = 0; id < b->count; id++) {
+        if (same_mark(disk[id], b->base[id])) continue;   // not changed on disk
+
+        Module *m = NULL;
+        Component *c = module_list_component(modules, id, &m);
+
+        // Not edited here since, as far as marks.csv can tell
+        if (same_mark(written_mark(c->mark), b->base[id])) {
+            c->mark = disk[id] < 0.0 ? -1.0 : disk[id];
+            report_cache_mark_dirty(rc, m, (size_t)(c - m->components));
+            out->applied++;
+        } else if (!same_mark(c->mark, disk[id])) {
+            fprintf(log, "Conflict: %s '%s' edited here (", m->code, c->name);
+            if (c->mark < 0.0) fprintf(log, "unset"); else fprintf(log, "%.2f", c->mark);
+            fprintf(log, ") and on disk (");
+            if (disk[id] < 0.0) fprintf(log, "unset"); else fprintf(log, "%.2f", disk[id]);
+            fprintf(log, "); keeping the local mark\n");
+            out->conflicts++;
+        }
+        b->base[id] = disk[id];
+    }
+
+    free(disk);
+    return 1;
+}
+
+/* -------------------- Reloading the schema -------------------- */
+
+static int same_component(const Component *a, const Component *b) {
+    return a->weight == b->weight && a->group_id == b->group_id && a->best_of == b->best_of;
+}
+
+// Counts what differs between old and fresh into out; 1 if anything does.
+static int schema_diff(ModuleList *old, ModuleList *fresh, SchemaReload *out) {
+    memset(out, 0, sizeof *out);
+
+    for (size_t i = 0; i < fresh->count; i++) {
+        Module *m = &fresh->items[i];
+        Module *was = module_list_find_by_id(old, m->id);
+        if (!was) {
+            out->modules_added++;
+        } else if (was->credits != m->credits || strcmp(was->code, m->code) != 0 ||
+                   strcmp(was->title, m->title) != 0) {
+            out->modules_changed++;
+        }
+        for (size_t j = 0; j < m->component_count; j++) {
+            Component *c = was ? module_find_component_by_name(was, m->components[j].name) : NULL;
+            if (!c) out->components_added++;
+            else if (!same_component(c, &m->components[j])) out->components_changed++;
+        }
+    }
+
+    for (size_t i = 0; i < old->count; i++) {
+        Module *m = &old->items[i];
+        Module *now = module_list_find_by_id(fresh, m->id);
+        if (!now) out->modules_removed++;
+        for (size_t j = 0; j < m->component_count; j++) {
+            if (!now || !module_find_component_by_name(now, m->components[j].name)) {
+                out->components_removed++;
+            }
+        }
+    }
+
+    return old->count != fresh->count || old->component_total != fresh->component_total ||
+           out->modules_added || out->modules_removed || out->modules_changed ||
+           out->components_added || out->components_removed || out->components_changed;
+}
+
+int schema_reload(ModuleList *modules, MarksBase *b, const char *modules_path,
+                  const char *components_path, SchemaReload *out) {
+    memset(out, 0, sizeof *out);
+
+    ModuleList fresh;
+    module_list_init(&fresh);
+    if (!reload_schema(&fresh, modules_path, components_path)) {
+        module_list_free(&fresh);
+        return 0;
+    }
+
+    if (!schema_diff(modules, &fresh, out)) {
+        module_list_free(&fresh);
+        return 1;
+    }
+
+    double *base = b->base ? unset_marks(fresh.component_total) : NULL;
+    if (b->base && !base) {
+        module_list_free(&fresh);
+        return 0;
+    }
+
+    for (size_t i = 0; i < fresh.count; i++) {
+        Module *m = &fresh.items[i];
+        for (size_t j = 0; j < m->component_count; j++) {
+            long id = module_list_component_id(modules, m->id, m->components[j].name);
+            if (id >= 0) m->components[j].mark = module_list_component(modules, (size_t)id, NULL)->mark;
+        }
+    }
+    if (base) {
+        for (size_t id = 0; id < fresh.component_total; id++) {
+            const ComponentRef *r = &fresh.component_refs[id];
+            const char *name = fresh.items[r->module].components[r->component].name;
+            long was = module_list_component_id(modules, r->module_id, name);
+            if (was >= 0 && (size_t)was < b->count) base[id] = b->base[was];
+        }
+        free(b->base);
+        b->base = base;
+        b->count = fresh.component_total;
+    }
+
+    module_list_free(modules);
+    *modules = fresh;
+    return 1;
+}